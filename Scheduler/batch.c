@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "scheduler.h"
+
+#define INPUT_SUFFIX ".in"
+// Not ".out", so a batch over test inputs never overwrites their expected
+// output.
+#define OUTPUT_SUFFIX ".batch.out"
+
+// One input file of the batch and the result of simulating it.
+typedef struct
+{
+   char* inputFile;
+   char* outputFile;
+   int result;
+   schedulerSummary summary;
+} batchJob;
+
+// Work shared by the threads of the pool. Each thread takes the next job
+// until there are none left.
+typedef struct
+{
+   batchJob* jobs;
+   int jobCount;
+   int nextJob;
+   pthread_mutex_t lock;
+} batchQueue;
+
+/** Prototypes **/
+void addJob(batchJob** jobs, int* jobCount, int* capacity, const char* inputFile);
+int addDirectory(batchJob** jobs, int* jobCount, int* capacity, const char* path);
+int compareJobs(const void* a, const void* b);
+void runJob(batchJob* job);
+void* runWorker(void* arg);
+void printBatchSummary(batchJob* jobs, int jobCount);
+void printAverages(long long finished, long long totalWait, long long totalIoWait, long long totalTurnaround);
+
+int runBatch(char* paths[], int pathCount)
+{
+   batchJob* jobs = NULL;
+   int jobCount = 0;
+   int capacity = 0;
+   int result = 0;
+
+   // Gather the input files. Directories are expanded in name order.
+   int i;
+   for (i = 0; i < pathCount; i++)
+   {
+      struct stat info;
+      if (stat(paths[i], &info) < 0)
+      {
+         fprintf(stderr, "Can't find input %s\n", paths[i]);
+         result = -1;
+      }
+      else if (S_ISDIR(info.st_mode))
+      {
+         int first = jobCount;
+         if (addDirectory(&jobs, &jobCount, &capacity, paths[i]) < 0)
+         {
+            result = -1;
+         }
+         qsort(&jobs[first], jobCount - first, sizeof(batchJob), compareJobs);
+      }
+      else
+      {
+         addJob(&jobs, &jobCount, &capacity, paths[i]);
+      }
+   }
+
+   // Start one worker per core, but no more than there are jobs.
+   int threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+   if (threadCount > jobCount)
+   {
+      threadCount = jobCount;
+   }
+   if (threadCount < 1)
+   {
+      threadCount = 1;
+   }
+
+   batchQueue queue;
+   queue.jobs = jobs;
+   queue.jobCount = jobCount;
+   queue.nextJob = 0;
+   pthread_mutex_init(&queue.lock, NULL);
+
+   pthread_t* threads = calloc(threadCount, sizeof(pthread_t));
+   int started = 0;
+   for (i = 0; i < threadCount; i++)
+   {
+      if (0 == pthread_create(&threads[started], NULL, runWorker, &queue))
+      {
+         started++;
+      }
+   }
+
+   // Without any threads, do the work here.
+   if (0 == started)
+   {
+      runWorker(&queue);
+   }
+
+   for (i = 0; i < started; i++)
+   {
+      pthread_join(threads[i], NULL);
+   }
+
+   pthread_mutex_destroy(&queue.lock);
+   free(threads);
+
+   printBatchSummary(jobs, jobCount);
+
+   for (i = 0; i < jobCount; i++)
+   {
+      if (0 != jobs[i].result)
+      {
+         result = -1;
+      }
+      free(jobs[i].inputFile);
+      free(jobs[i].outputFile);
+   }
+   free(jobs);
+
+   return result;
+}
+
+// Add an input file to the batch. "name.in" is traced to "name.batch.out",
+// any other file gets ".batch.out" appended.
+void addJob(batchJob** jobs, int* jobCount, int* capacity, const char* inputFile)
+{
+   if (*jobCount == *capacity)
+   {
+      *capacity = (*capacity > 0) ? (2 * *capacity) : 16;
+      *jobs = realloc(*jobs, *capacity * sizeof(batchJob));
+   }
+
+   size_t length = strlen(inputFile);
+   size_t suffixLength = strlen(INPUT_SUFFIX);
+   if ((length > suffixLength) && (0 == strcmp(inputFile + length - suffixLength, INPUT_SUFFIX)))
+   {
+      length -= suffixLength;
+   }
+
+   batchJob* job = &(*jobs)[(*jobCount)++];
+   memset(job, 0, sizeof(batchJob));
+   job->inputFile = strdup(inputFile);
+   job->outputFile = malloc(length + strlen(OUTPUT_SUFFIX) + 1);
+   memcpy(job->outputFile, inputFile, length);
+   strcpy(job->outputFile + length, OUTPUT_SUFFIX);
+}
+
+// Add every *.in file of a directory to the batch.
+int addDirectory(batchJob** jobs, int* jobCount, int* capacity, const char* path)
+{
+   DIR* dir = opendir(path);
+   if (NULL == dir)
+   {
+      fprintf(stderr, "Can't open input directory %s\n", path);
+      return -1;
+   }
+
+   struct dirent* entry;
+   while (NULL != (entry = readdir(dir)))
+   {
+      size_t length = strlen(entry->d_name);
+      size_t suffixLength = strlen(INPUT_SUFFIX);
+      if ((length <= suffixLength) ||
+          (0 != strcmp(entry->d_name + length - suffixLength, INPUT_SUFFIX)))
+      {
+         continue;
+      }
+
+      char* inputFile = malloc(strlen(path) + length + 2);
+      sprintf(inputFile, "%s/%s", path, entry->d_name);
+      addJob(jobs, jobCount, capacity, inputFile);
+      free(inputFile);
+   }
+
+   closedir(dir);
+   return 0;
+}
+
+int compareJobs(const void* a, const void* b)
+{
+   return strcmp(((const batchJob*) a)->inputFile, ((const batchJob*) b)->inputFile);
+}
+
+// Simulate a single input file with its own scheduler.
+void runJob(batchJob* job)
+{
+   scheduler* s = createScheduler();
+
+   job->result = setSchedulerOutputFile(s, job->outputFile);
+   if (0 == job->result)
+   {
+      job->result = loadScheduler(s, job->inputFile);
+   }
+   if (0 == job->result)
+   {
+      job->result = runScheduler(s);
+   }
+   getSchedulerSummary(s, &job->summary);
+
+   destroyScheduler(s);
+}
+
+void* runWorker(void* arg)
+{
+   batchQueue* queue = arg;
+
+   while (1)
+   {
+      pthread_mutex_lock(&queue->lock);
+      int next = queue->nextJob++;
+      pthread_mutex_unlock(&queue->lock);
+
+      if (next >= queue->jobCount)
+      {
+         break;
+      }
+
+      runJob(&queue->jobs[next]);
+   }
+
+   return NULL;
+}
+
+// Print one line per input, then the totals of the whole batch.
+void printBatchSummary(batchJob* jobs, int jobCount)
+{
+   long long processCount = 0;
+   long long finishedCount = 0;
+   long long totalWait = 0;
+   long long totalIoWait = 0;
+   long long totalTurnaround = 0;
+   int failedCount = 0;
+
+   int i;
+   for (i = 0; i < jobCount; i++)
+   {
+      batchJob* job = &jobs[i];
+      schedulerSummary* summary = &job->summary;
+
+      if (0 != job->result)
+      {
+         printf("%s: failed\n", job->inputFile);
+         failedCount++;
+         continue;
+      }
+
+      printf("%s: %s finished at time %lld, %d of %d processes finished",
+             job->inputFile, job->outputFile, summary->endTime,
+             summary->finishedCount, summary->processCount);
+      printAverages(summary->finishedCount, summary->totalWait, summary->totalIoWait,
+                    summary->totalTurnaround);
+
+      processCount += summary->processCount;
+      finishedCount += summary->finishedCount;
+      totalWait += summary->totalWait;
+      totalIoWait += summary->totalIoWait;
+      totalTurnaround += summary->totalTurnaround;
+   }
+
+   printf("\n%d inputs, %d failed, %lld of %lld processes finished",
+          jobCount, failedCount, finishedCount, processCount);
+   printAverages(finishedCount, totalWait, totalIoWait, totalTurnaround);
+}
+
+// End a summary line with the averages the aggregate stats of a trace
+// show, which include the I/O wait once there is any.
+void printAverages(long long finished, long long totalWait, long long totalIoWait, long long totalTurnaround)
+{
+   if ((finished > 0) && (totalIoWait > 0))
+   {
+      printf(", average wait %.2f, average io %.2f, average turnaround %.2f",
+             (double) totalWait / finished, (double) totalIoWait / finished,
+             (double) totalTurnaround / finished);
+   }
+   else if (finished > 0)
+   {
+      printf(", average wait %.2f, average turnaround %.2f",
+             (double) totalWait / finished, (double) totalTurnaround / finished);
+   }
+   printf("\n");
+}
@@ -0,0 +1,11 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Simulate many input files in parallel on a pool of threads, one per core.
+// Each path is either an input file or a directory whose *.in files are all
+// simulated. The trace of "name.in" is written to "name.batch.out" next to
+// it, and a summary line per input is printed to stdout once all of them are
+// done.
+int runBatch(char* paths[], int pathCount);
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "scheduler.h"
+#include "workload.h"
+
+#define DEFAULT_SCALES "10,1000,100000,10000000"
+#define DEFAULT_ALGORITHMS "fcfs,sjf,rr"
+#define MAX_LIST 32
+
+// What a child process measures and sends back to the benchmark.
+typedef struct
+{
+   int result;
+   double loadSeconds;
+   double runSeconds;
+   schedulerSummary summary;
+} benchResult;
+
+/** Prototypes **/
+int splitList(char* list, char* items[]);
+int runCase(const workloadOptions* options, benchResult* result, long* peakKiB);
+void measureCase(const workloadOptions* options, int fd);
+double elapsedSeconds(struct timespec* start, struct timespec* end);
+
+// Time each algorithm on generated workloads of each scale. Every case runs
+// in a child process of its own, so its peak RSS is its alone. The trace
+// is formatted as usual and written to /dev/null.
+int main(int argc, char *argv[])
+{
+   workloadOptions options;
+   char scaleList[256] = DEFAULT_SCALES;
+   char algorithmList[256] = DEFAULT_ALGORITHMS;
+   setDefaultWorkload(&options);
+
+   int i;
+   for (i = 1; i < argc; i += 2)
+   {
+      if ((i + 1 < argc) && (0 == strcmp(argv[i], "--scales")))
+      {
+         snprintf(scaleList, sizeof(scaleList), "%s", argv[i + 1]);
+      }
+      else if ((i + 1 < argc) && (0 == strcmp(argv[i], "--algorithms")))
+      {
+         snprintf(algorithmList, sizeof(algorithmList), "%s", argv[i + 1]);
+      }
+      else if ((i + 1 >= argc) || (0 != setWorkloadOption(&options, argv[i], argv[i + 1])))
+      {
+         fprintf(stderr, "Usage: %s [--scales %s] [--algorithms %s] [options]\n",
+                 argv[0], DEFAULT_SCALES, DEFAULT_ALGORITHMS);
+         printWorkloadUsage(stderr);
+         return -1;
+      }
+   }
+
+   char* scales[MAX_LIST];
+   char* algorithms[MAX_LIST];
+   int scaleCount = splitList(scaleList, scales);
+   int algorithmCount = splitList(algorithmList, algorithms);
+   int failedCount = 0;
+
+   printf("%-9s %10s %12s %9s %9s %14s %10s\n",
+          "algorithm", "processes", "events", "load s", "run s", "events/s", "peak RSS");
+
+   int a;
+   for (a = 0; a < algorithmCount; a++)
+   {
+      int c;
+      for (c = 0; c < scaleCount; c++)
+      {
+         benchResult result;
+         long peakKiB = 0;
+
+         options.processCount = atoi(scales[c]);
+         if (0 != setWorkloadOption(&options, "--use", algorithms[a]))
+         {
+            fprintf(stderr, "Unknown algorithm %s\n", algorithms[a]);
+            return -1;
+         }
+
+         if (0 != runCase(&options, &result, &peakKiB))
+         {
+            printf("%-9s %10d failed\n", algorithms[a], options.processCount);
+            failedCount++;
+            continue;
+         }
+
+         printf("%-9s %10d %12lld %9.3f %9.3f %14.0f %7.1f MiB\n",
+                algorithms[a], options.processCount, result.summary.events,
+                result.loadSeconds, result.runSeconds,
+                (result.runSeconds > 0) ? result.summary.events / result.runSeconds : 0.0,
+                peakKiB / 1024.0);
+         fflush(stdout);
+      }
+   }
+
+   return (failedCount > 0) ? -1 : 0;
+}
+
+// Split a comma separated list in place.
+int splitList(char* list, char* items[])
+{
+   int count = 0;
+   char* item = strtok(list, ",");
+
+   while ((NULL != item) && (count < MAX_LIST))
+   {
+      items[count++] = item;
+      item = strtok(NULL, ",");
+   }
+
+   return count;
+}
+
+// Run one case in a child process and collect what it measured.
+int runCase(const workloadOptions* options, benchResult* result, long* peakKiB)
+{
+   int pipeFds[2];
+   if (pipe(pipeFds) < 0)
+   {
+      return -1;
+   }
+
+   fflush(stdout);
+   pid_t child = fork();
+   if (child < 0)
+   {
+      close(pipeFds[0]);
+      close(pipeFds[1]);
+      return -1;
+   }
+
+   if (0 == child)
+   {
+      close(pipeFds[0]);
+      measureCase(options, pipeFds[1]);
+      _exit(0);
+   }
+
+   close(pipeFds[1]);
+   ssize_t count;
+   do
+   {
+      count = read(pipeFds[0], result, sizeof(benchResult));
+   } while ((count < 0) && (EINTR == errno));
+   close(pipeFds[0]);
+
+   int status;
+   struct rusage usage;
+   if (wait4(child, &status, 0, &usage) < 0)
+   {
+      return -1;
+   }
+   *peakKiB = usage.ru_maxrss;
+
+   if ((sizeof(benchResult) != count) || !WIFEXITED(status))
+   {
+      return -1;
+   }
+
+   return result->result;
+}
+
+// Generate the workload, then time loading and simulating it. The peak RSS
+// includes the text of the workload, since the scheduler reads it in place.
+void measureCase(const workloadOptions* options, int fd)
+{
+   benchResult result;
+   struct timespec start, loaded, end;
+   size_t size;
+
+   memset(&result, 0, sizeof(benchResult));
+   char* data = generateWorkload(options, &size);
+   scheduler* s = createScheduler();
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   result.result = setSchedulerOutputFile(s, "/dev/null");
+   if (0 == result.result)
+   {
+      result.result = loadSchedulerData(s, data, size);
+   }
+   clock_gettime(CLOCK_MONOTONIC, &loaded);
+   if (0 == result.result)
+   {
+      result.result = runScheduler(s);
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   getSchedulerSummary(s, &result.summary);
+   result.loadSeconds = elapsedSeconds(&start, &loaded);
+   result.runSeconds = elapsedSeconds(&loaded, &end);
+
+   destroyScheduler(s);
+   free(data);
+
+   if (write(fd, &result, sizeof(benchResult)) != sizeof(benchResult))
+   {
+      _exit(1);
+   }
+   close(fd);
+}
+
+double elapsedSeconds(struct timespec* start, struct timespec* end)
+{
+   return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Run every processes-<Name>-TestN.in here and compare what it writes with
+# processes-<Name>-TestN.out. The name picks how the input is run:
+#    Stream     the input on stdin, the trace on stdout
+#    Binary     the binary trace, turned back into text by decode, which
+#               must also reject the trace cut short anywhere
+#    WhatIf     the what-if report on stdout for the changes in
+#               processes-WhatIf-TestN.changes
+#    Resume     resumed from processes-Resume-TestN.checkpoint and its
+#               .finished log, with the output processes-Resume-TestN.partial
+#               that the stopped run left, which must end up as the output
+#               of a run that was never stopped
+#    anything   processes.in into processes.out
+# Run from the Scheduler directory after make, e.g. make test.
+
+tests=$(cd "$(dirname "$0")" && pwd)
+bin=$(pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+count=0
+for input in "$tests"/processes-*-Test*.in
+do
+   test=${input%.in}
+   name=$(basename "$test")
+   mode=${name#processes-}
+   mode=${mode%-Test*}
+   rm -rf "$work"/*
+   cp "$input" "$work/processes.in"
+   result=processes.out
+
+   case $mode in
+      Stream)
+         (cd "$work" && "$bin/scheduler" --stream < processes.in > processes.out 2>/dev/null)
+         ;;
+      Binary)
+         (cd "$work" && "$bin/scheduler" --binary > /dev/null 2>&1 &&
+          "$bin/decode" processes.trace > processes.out 2>/dev/null)
+         # Every part of the trace short of all of it must fail to decode.
+         size=$(wc -c < "$work/processes.trace")
+         cut=0
+         while [ "$cut" -lt "$size" ]
+         do
+            if head -c "$cut" "$work/processes.trace" | "$bin/decode" > /dev/null 2>&1
+            then
+               echo "FAILED $name: the first $cut bytes of the trace decode"
+               failed=$((failed + 1))
+               break
+            fi
+            cut=$((cut + 1))
+         done
+         ;;
+      WhatIf)
+         cp "$test.changes" "$work/changes"
+         result=report.out
+         (cd "$work" && "$bin/scheduler" --what-if changes > report.out 2>/dev/null)
+         ;;
+      Resume)
+         cp "$test.checkpoint" "$work/checkpoint"
+         cp "$test.checkpoint.finished" "$work/checkpoint.finished"
+         cp "$test.partial" "$work/processes.out"
+         (cd "$work" && "$bin/scheduler" --checkpoint checkpoint --resume > /dev/null 2>&1)
+         ;;
+      *)
+         (cd "$work" && "$bin/scheduler" > /dev/null 2>&1)
+         ;;
+   esac
+
+   count=$((count + 1))
+   if ! cmp -s "$work/$result" "$test.out"
+   then
+      echo "FAILED $name"
+      failed=$((failed + 1))
+   fi
+done
+
+echo "$count tests, $failed failed"
+[ 0 -eq "$failed" ]
@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define INPUT_BUFFER_SIZE (1 << 20)
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+// Longest name a trace can hold. Anything longer is a damaged trace.
+#define MAX_NAME_LENGTH (1 << 20)
+#define BOOL int
+#define TRUE 1
+#define FALSE 0
+
+// Buffered reader over the binary trace.
+typedef struct
+{
+   int fd;
+   unsigned char* buffer;
+   int start;
+   int end;
+   BOOL failed;
+} traceReader;
+
+// Names of the processes, indexed by their position in the input.
+typedef struct
+{
+   char** names;
+   int* lengths;
+   size_t capacity;
+} nameTable;
+
+/** Prototypes **/
+int readByte(traceReader* r);
+unsigned long long readVarint(traceReader* r);
+long long readSignedVarint(traceReader* r);
+void setName(nameTable* t, unsigned long long idx, traceReader* r);
+void writeName(nameTable* t, unsigned long long idx);
+void writeCpuSuffix(int cpuCount, unsigned long long cpu);
+int decodeTrace(traceReader* r);
+
+// Turn a binary trace from the given file, or stdin, back into the text
+// trace on stdout.
+int main(int argc, char *argv[])
+{
+   if (argc > 2)
+   {
+      fprintf(stderr, "Usage: %s [binary trace]\n", argv[0]);
+      return -1;
+   }
+
+   traceReader r = { STDIN_FILENO, NULL, 0, 0, FALSE };
+   if (argc > 1)
+   {
+      r.fd = open(argv[1], O_RDONLY);
+      if (r.fd < 0)
+      {
+         fprintf(stderr, "Can't open trace %s\n", argv[1]);
+         return -1;
+      }
+   }
+
+   r.buffer = malloc(INPUT_BUFFER_SIZE);
+   setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+   int result = decodeTrace(&r);
+
+   free(r.buffer);
+   if (argc > 1)
+   {
+      close(r.fd);
+   }
+
+   if (0 != fflush(stdout))
+   {
+      fprintf(stderr, "Can't write the text trace\n");
+      result = -1;
+   }
+
+   return result;
+}
+
+int decodeTrace(traceReader* r)
+{
+   char magic[TRACE_MAGIC_LENGTH];
+   int i;
+   for (i = 0; i < TRACE_MAGIC_LENGTH; i++)
+   {
+      magic[i] = readByte(r);
+   }
+   if ((0 != memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LENGTH)) || (TRACE_VERSION != readByte(r)))
+   {
+      fprintf(stderr, "Not a binary trace of version %d\n", TRACE_VERSION);
+      return -1;
+   }
+
+   unsigned long long cpus = readVarint(r);
+   if (r->failed || (cpus < 1) || (cpus > INT_MAX))
+   {
+      fprintf(stderr, "Not a trace of 1 or more CPUs\n");
+      return -1;
+   }
+   int cpuCount = cpus;
+
+   // The configuration text comes out as it is.
+   int c;
+   while ((c = readByte(r)) > 0)
+   {
+      putchar(c);
+   }
+
+   nameTable names = { NULL, NULL, 0 };
+   unsigned long long nameCount = readVarint(r);
+   unsigned long long n;
+   for (n = 0; (n < nameCount) && !r->failed; n++)
+   {
+      setName(&names, n, r);
+   }
+
+   // CPUs of the last idle record.
+   int* idle = NULL;
+   int idleCapacity = 0;
+
+   long long time = 0;
+   long long finishTime = 0;
+   BOOL ended = FALSE;
+   int type;
+   while (!r->failed && !ended && ((type = readByte(r)) >= 0))
+   {
+      if ((type <= TraceSchedulerFinished) || (TraceStartedIo == type) || (TraceFinishedIo == type))
+      {
+         time += readVarint(r);
+      }
+
+      switch (type)
+      {
+         case TraceArrived:
+            printf("Time %lld: ", time);
+            writeName(&names, readVarint(r));
+            fputs(" arrived\n", stdout);
+            break;
+
+         case TraceSelected:
+         {
+            unsigned long long idx = readVarint(r);
+            long long burst = readSignedVarint(r);
+            printf("Time %lld: ", time);
+            writeName(&names, idx);
+            printf(" selected (burst %lld)", burst);
+            writeCpuSuffix(cpuCount, (cpuCount > 1) ? readVarint(r) : 0);
+            break;
+         }
+
+         case TraceFinished:
+            printf("Time %lld: ", time);
+            writeName(&names, readVarint(r));
+            fputs(" finished", stdout);
+            writeCpuSuffix(cpuCount, (cpuCount > 1) ? readVarint(r) : 0);
+            break;
+
+         case TraceStolen:
+         {
+            unsigned long long idx = readVarint(r);
+            unsigned long long thief = readVarint(r);
+            unsigned long long victim = readVarint(r);
+            printf("Time %lld: CPU %llu stole ", time, thief);
+            writeName(&names, idx);
+            printf(" from CPU %llu\n", victim);
+            break;
+         }
+
+         case TraceIdle:
+         {
+            long long ticks = readVarint(r);
+            unsigned long long idleCount = (cpuCount > 1) ? readVarint(r) : 1;
+            if ((idleCount < 1) || (idleCount > (unsigned long long) cpuCount))
+            {
+               fprintf(stderr, "Idle record of %llu CPUs in a trace of %d\n", idleCount, cpuCount);
+               r->failed = TRUE;
+               break;
+            }
+            if ((int) idleCount > idleCapacity)
+            {
+               int* grown = realloc(idle, idleCount * sizeof(int));
+               if (NULL == grown)
+               {
+                  fprintf(stderr, "Out of memory for the idle CPUs\n");
+                  r->failed = TRUE;
+                  break;
+               }
+               idle = grown;
+               idleCapacity = idleCount;
+            }
+            for (i = 0; i < (int) idleCount; i++)
+            {
+               unsigned long long cpu = (cpuCount > 1) ? readVarint(r) : 0;
+               if (cpu >= (unsigned long long) cpuCount)
+               {
+                  fprintf(stderr, "Idle record of CPU %llu in a trace of %d\n", cpu, cpuCount);
+                  r->failed = TRUE;
+               }
+               idle[i] = cpu;
+            }
+            if (r->failed)
+            {
+               break;
+            }
+
+            long long t;
+            for (t = time; t < time + ticks; t++)
+            {
+               for (i = 0; i < (int) idleCount; i++)
+               {
+                  printf("Time %lld: IDLE", t);
+                  writeCpuSuffix(cpuCount, idle[i]);
+               }
+            }
+            break;
+         }
+
+         case TraceSchedulerFinished:
+            finishTime = time;
+            printf("Finished at time %lld\n\n", time);
+            break;
+
+         case TraceStats:
+         {
+            unsigned long long idx = readVarint(r);
+            long long wait = readSignedVarint(r);
+            long long turnaround = readSignedVarint(r);
+            writeName(&names, idx);
+            printf(" wait %lld turnaround %lld\n", wait, turnaround);
+            break;
+         }
+
+         case TraceUnfinished:
+            writeName(&names, readVarint(r));
+            fputs(" didn't finish\n", stdout);
+            break;
+
+         case TraceCpuStats:
+         {
+            unsigned long long cpu = readVarint(r);
+            long long busy = readVarint(r);
+            long long utilization = (finishTime > 0) ? (busy * 10000 / finishTime) : 0;
+            printf("CPU %llu busy %lld idle %lld utilization %lld.%02lld%%\n",
+                   cpu, busy, finishTime - busy, utilization / 100, utilization % 100);
+            break;
+         }
+
+         case TraceAggregate:
+         {
+            long long finished = readVarint(r);
+            long long processCount = readVarint(r);
+            long long totalWait = readSignedVarint(r);
+            long long totalTurnaround = readSignedVarint(r);
+            printf("%lld of %lld processes finished", finished, processCount);
+            if (finished > 0)
+            {
+               printf(", average wait %.2f, average turnaround %.2f",
+                      (double) totalWait / finished, (double) totalTurnaround / finished);
+            }
+            putchar('\n');
+            break;
+         }
+
+         case TraceName:
+            setName(&names, readVarint(r), r);
+            break;
+
+         case TraceStartedIo:
+         {
+            unsigned long long idx = readVarint(r);
+            long long io = readVarint(r);
+            printf("Time %lld: ", time);
+            writeName(&names, idx);
+            printf(" started I/O (io %lld)", io);
+            writeCpuSuffix(cpuCount, (cpuCount > 1) ? readVarint(r) : 0);
+            break;
+         }
+
+         case TraceFinishedIo:
+            printf("Time %lld: ", time);
+            writeName(&names, readVarint(r));
+            fputs(" finished I/O\n", stdout);
+            break;
+
+         case TraceIoStats:
+         {
+            unsigned long long idx = readVarint(r);
+            long long wait = readSignedVarint(r);
+            long long io = readVarint(r);
+            long long turnaround = readSignedVarint(r);
+            writeName(&names, idx);
+            printf(" wait %lld io %lld turnaround %lld\n", wait, io, turnaround);
+            break;
+         }
+
+         case TraceIoAggregate:
+         {
+            long long finished = readVarint(r);
+            long long processCount = readVarint(r);
+            long long totalWait = readSignedVarint(r);
+            long long totalIo = readVarint(r);
+            long long totalTurnaround = readSignedVarint(r);
+            printf("%lld of %lld processes finished", finished, processCount);
+            if (finished > 0)
+            {
+               printf(", average wait %.2f, average io %.2f, average turnaround %.2f",
+                      (double) totalWait / finished, (double) totalIo / finished,
+                      (double) totalTurnaround / finished);
+            }
+            putchar('\n');
+            break;
+         }
+
+         case TraceEnd:
+            ended = TRUE;
+            break;
+
+         default:
+            fprintf(stderr, "Unknown record type %d\n", type);
+            r->failed = TRUE;
+            break;
+      }
+   }
+
+   if (!r->failed && !ended)
+   {
+      fprintf(stderr, "The trace ends early\n");
+      r->failed = TRUE;
+   }
+
+   for (n = 0; n < names.capacity; n++)
+   {
+      free(names.names[n]);
+   }
+   free(names.names);
+   free(names.lengths);
+   free(idle);
+
+   return r->failed ? -1 : 0;
+}
+
+/** Reading **/
+// Returns -1 at the end of the trace.
+int readByte(traceReader* r)
+{
+   if (r->start == r->end)
+   {
+      ssize_t count;
+      do
+      {
+         count = read(r->fd, r->buffer, INPUT_BUFFER_SIZE);
+      } while ((count < 0) && (EINTR == errno));
+
+      if (count <= 0)
+      {
+         if (count < 0)
+         {
+            fprintf(stderr, "Can't read the trace: %s\n", strerror(errno));
+            r->failed = TRUE;
+         }
+         return -1;
+      }
+
+      r->start = 0;
+      r->end = count;
+   }
+
+   return r->buffer[r->start++];
+}
+
+unsigned long long readVarint(traceReader* r)
+{
+   unsigned long long val = 0;
+   int shift = 0;
+   int byte;
+
+   do
+   {
+      byte = readByte(r);
+      if (byte < 0)
+      {
+         fprintf(stderr, "The trace ends in the middle of a record\n");
+         r->failed = TRUE;
+         return 0;
+      }
+      val |= (unsigned long long) (byte & 0x7F) << shift;
+      shift += 7;
+   } while ((byte & 0x80) && (shift < 64));
+
+   return val;
+}
+
+long long readSignedVarint(traceReader* r)
+{
+   unsigned long long val = readVarint(r);
+   return (long long) (val >> 1) ^ -(long long) (val & 1);
+}
+
+/** Names **/
+// Processes are indexed by an int, and names are at most MAX_NAME_LENGTH
+// bytes. Anything else is a damaged trace.
+void setName(nameTable* t, unsigned long long idx, traceReader* r)
+{
+   unsigned long long length = readVarint(r);
+   if (r->failed || (idx > INT_MAX) || (length > MAX_NAME_LENGTH))
+   {
+      fprintf(stderr, "Bad name record in the trace\n");
+      r->failed = TRUE;
+      return;
+   }
+
+   if (idx >= t->capacity)
+   {
+      size_t capacity = (t->capacity > 0) ? (2 * t->capacity) : 1024;
+      while (capacity <= idx)
+      {
+         capacity *= 2;
+      }
+      char** names = realloc(t->names, capacity * sizeof(char*));
+      if (NULL != names)
+      {
+         t->names = names;
+      }
+      int* lengths = realloc(t->lengths, capacity * sizeof(int));
+      if (NULL != lengths)
+      {
+         t->lengths = lengths;
+      }
+      if ((NULL == names) || (NULL == lengths))
+      {
+         fprintf(stderr, "Out of memory for the names of the trace\n");
+         r->failed = TRUE;
+         return;
+      }
+      memset(&t->names[t->capacity], 0, (capacity - t->capacity) * sizeof(char*));
+      memset(&t->lengths[t->capacity], 0, (capacity - t->capacity) * sizeof(int));
+      t->capacity = capacity;
+   }
+
+   free(t->names[idx]);
+   t->lengths[idx] = 0;
+   t->names[idx] = malloc(length + 1);
+   if (NULL == t->names[idx])
+   {
+      fprintf(stderr, "Out of memory for the names of the trace\n");
+      r->failed = TRUE;
+      return;
+   }
+   t->lengths[idx] = length;
+
+   unsigned long long i;
+   for (i = 0; i < length; i++)
+   {
+      int byte = readByte(r);
+      if (byte < 0)
+      {
+         fprintf(stderr, "The trace ends in the middle of a record\n");
+         r->failed = TRUE;
+         return;
+      }
+      t->names[idx][i] = byte;
+   }
+}
+
+void writeName(nameTable* t, unsigned long long idx)
+{
+   if ((idx < t->capacity) && (NULL != t->names[idx]))
+   {
+      fwrite(t->names[idx], 1, t->lengths[idx], stdout);
+   }
+}
+
+void writeCpuSuffix(int cpuCount, unsigned long long cpu)
+{
+   if (cpuCount > 1)
+   {
+      printf(" on CPU %llu", cpu);
+   }
+   putchar('\n');
+}
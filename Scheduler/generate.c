@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "workload.h"
+
+// Write a synthetic workload for the scheduler to stdout, or to the file
+// given with -o. The output can be piped straight into "scheduler --stream".
+int main(int argc, char *argv[])
+{
+   workloadOptions options;
+   const char* outputFile = NULL;
+   setDefaultWorkload(&options);
+
+   int i;
+   for (i = 1; i < argc; i += 2)
+   {
+      if ((i + 1 < argc) && (0 == strcmp(argv[i], "-o")))
+      {
+         outputFile = argv[i + 1];
+      }
+      else if ((i + 1 >= argc) || (0 != setWorkloadOption(&options, argv[i], argv[i + 1])))
+      {
+         fprintf(stderr, "Usage: %s [-o <output file>] [options]\n", argv[0]);
+         printWorkloadUsage(stderr);
+         return -1;
+      }
+   }
+
+   int fd = STDOUT_FILENO;
+   if (NULL != outputFile)
+   {
+      fd = open(outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+      {
+         fprintf(stderr, "Can't open output file %s\n", outputFile);
+         return -1;
+      }
+   }
+
+   size_t size;
+   char* data = generateWorkload(&options, &size);
+   int result = 0;
+
+   size_t written = 0;
+   while (written < size)
+   {
+      ssize_t count = write(fd, data + written, size - written);
+      if (count < 0)
+      {
+         if (EINTR == errno)
+         {
+            continue;
+         }
+         fprintf(stderr, "Can't write the workload\n");
+         result = -1;
+         break;
+      }
+      written += count;
+   }
+
+   free(data);
+   if (NULL != outputFile)
+   {
+      close(fd);
+   }
+
+   return result;
+}
@@ -1,583 +1,218 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "scheduler.h"
 
 #define INPUT_FILE_NAME "processes.in"
 #define OUTPUT_FILE_NAME "processes.out"
-#define BUFFER_MAX_SIZE 256
-#define BOOL int
-#define TRUE 1
-#define FALSE 0
-#define MAX_INT 2147483647
-
-/** Datatypes **/
-// Scheduler type enum declaration (and corresponding string array)
-// Based on code from this source: https://goo.gl/eAU4bo
-#define foreach_schedulerType(schedulerType) \
-        schedulerType(FirstComeFirstServed)   \
-        schedulerType(ShortestJobFirst)  \
-        schedulerType(RoundRobin) \
-
-#define GENERATE_ENUM(ENUM) ENUM,
-#define GENERATE_STRING(STRING) #STRING,
-
-typedef enum {
-    foreach_schedulerType(GENERATE_ENUM)
-} schedulerTypeEnum;
-
-static const char *schedulerTypeString[] = {
-    foreach_schedulerType(GENERATE_STRING)
-};
-
-// Struct to hold process information.
-typedef struct
-{
-   char name[10];
-   int arrival;
-   // If this is true, then the process has arrived and has not finished.
-   BOOL isReady;
-   int burst;
-   int wait;
-   int startTime;
-   int endTime;
-} process;
-
-// Integer queue for round robin scheduling by process index
-typedef struct
-{
-   int *array;
-   int head;
-   int tail;
-   int capacity;
-} integerQueue;
-
-/** Prototypes **/
-void parseInputFile();
-void printConfiguration();
-void runFCFS();
-void runSJF();
-void runRR();
-
-BOOL isFull(integerQueue *q);
-BOOL isEmpty(integerQueue *q);
-BOOL contains(integerQueue *q, int key);
-void createQueue(integerQueue *q, int capacity);
-void destroyQueue(integerQueue *q);
-BOOL enqueue(integerQueue *q, int val);
-int dequeue(integerQueue *q);
-
-/** Globals **/
-int processCount;
-process* processes;
-int runtime;
-schedulerTypeEnum schedulerType;
-int quantum;
-FILE* outputFile;
-
+#define TRACE_FILE_NAME "processes.trace"
+#define STREAM_OPTION "--stream"
+#define BATCH_OPTION "--batch"
+#define METRICS_OPTION "--metrics"
+#define SUMMARY_OPTION "--summary"
+#define BINARY_OPTION "--binary"
+#define CHECKPOINT_OPTION "--checkpoint"
+#define RESUME_OPTION "--resume"
+#define WHAT_IF_OPTION "--what-if"
+#define CSV_SUFFIX ".csv"
+#define SNAPSHOT_COUNT 64
+#define WHAT_IF_LINE_LENGTH 1024
+
+int runWhatIfs(scheduler* s, const char* fileName);
+
+// Simulate processes.in into processes.out. With --stream, read the
+// processes from stdin and write the trace to stdout. With --batch, simulate
+// every given input file or directory of input files in parallel.
+// With --metrics, also write metrics of the run to a file, as CSV if its
+// name ends in .csv and as JSON otherwise. With --summary, only write
+// the aggregate stats instead of the trace. With --binary, write the
+// binary trace to processes.trace, or to stdout with --stream.
+// With --checkpoint, save the run to a file every few seconds, and with
+// --resume as well, go on from the run saved there. With --what-if, also
+// simulate again each change of a file of lines like
+// "P3 arrival 40 burst 12" once the run has finished, and write how the
+// stats change to stdout.
 int main(int argc, char *argv[])
 {
-   // Open the output file for writing.
-   // This should be done before anything else.
-   outputFile = fopen(OUTPUT_FILE_NAME, "w");
-   if (outputFile == NULL)
+   if ((argc > 2) && (0 == strcmp(argv[1], BATCH_OPTION)))
    {
-     fprintf(stderr, "Can't open output file %s\n", OUTPUT_FILE_NAME);
-     exit(-1);
+      return runBatch(&argv[2], argc - 2);
    }
 
-   // Parse the input file.
-   parseInputFile();
-
-   // Print relevant information about the set of processes to be scheduled.
-   printConfiguration();
-
-   // Based on the scheduling type, use the appropriate scheduling algorithm.
-   switch (schedulerType)
+   int streaming = 0;
+   int summaryOnly = 0;
+   int binaryTrace = 0;
+   int resume = 0;
+   const char* metricsFile = NULL;
+   const char* checkpointFile = NULL;
+   const char* whatIfFile = NULL;
+   int i;
+   for (i = 1; i < argc; i++)
    {
-      case FirstComeFirstServed:
+      if (0 == strcmp(argv[i], STREAM_OPTION))
       {
-         runFCFS();
-         break;
+         streaming = 1;
       }
-
-      case ShortestJobFirst:
+      else if (0 == strcmp(argv[i], SUMMARY_OPTION))
       {
-         runSJF();
-         break;
+         summaryOnly = 1;
       }
-
-      case RoundRobin:
+      else if (0 == strcmp(argv[i], BINARY_OPTION))
       {
-         runRR();
-         break;
+         binaryTrace = 1;
       }
-      default:
-         break;
-   }
-
-   // Close the output file and free memory used for the processes.
-   fclose(outputFile);
-   free(processes);
-
-   return 0;
-}
-
-// Parse the input file.
-// After this function is called, all globals have values that reflect
-// the content of the input.
-void parseInputFile()
-{
-   FILE* inputFile = fopen(INPUT_FILE_NAME, "r");
-   if (inputFile == NULL)
-   {
-      fprintf(stderr, "Can't open input file %s\n", INPUT_FILE_NAME);
-      exit(-1);
-   }
-
-   char buffer[BUFFER_MAX_SIZE];
-   char* token;
-   char* delims = " \t\n\r";
-   int processesIndex = 0;
-
-   // Read each line of the file.
-   while (fgets(buffer, BUFFER_MAX_SIZE, inputFile))
-   {
-      token = strtok(buffer, delims);
-
-      // Iterate through tokens of the line.
-      while (NULL != token)
+      else if (0 == strcmp(argv[i], RESUME_OPTION))
       {
-         // If '#', the rest of the line is a comment.
-         if ((strcmp(token, "#") == 0) || (strcmp(token, "end") == 0))
-         {
-            break;
-         }
-         else if (strcmp(token, "processcount") == 0)
-         {
-            token = strtok(NULL, delims);
-            processCount = atoi(token);
-            processes = calloc(processCount, sizeof(process));
-         }
-         else if (strcmp(token, "runfor") == 0)
-         {
-            token = strtok(NULL, delims);
-            runtime = atoi(token);
-         }
-         else if (strcmp(token, "use") == 0)
-         {
-            token = strtok(NULL, delims);
-
-            if (strcmp(token, "fcfs") == 0)
-            {
-               schedulerType = FirstComeFirstServed;
-            }
-            else if (strcmp(token, "sjf") == 0)
-            {
-               schedulerType = ShortestJobFirst;
-            }
-            else if (strcmp(token, "rr") == 0)
-            {
-               schedulerType = RoundRobin;
-            }
-            // Handle error
-            else
-            {
-               printf("Invalid scheduling type");
-            }
-         }
-         else if (strcmp(token, "quantum") == 0)
-         {
-            token = strtok(NULL, delims);
-            quantum = atoi(token);
-         }
-         else if (strcmp(token, "process") == 0)
-         {
-            process* p = &processes[processesIndex++];
-            token = strtok(NULL, delims);
-            while (NULL != token)
-            {
-               if (strcmp(token, "name") == 0)
-               {
-                  token = strtok(NULL, delims);
-                  strcpy(p->name, token);
-               }
-               else if (strcmp(token, "arrival") == 0)
-               {
-                  token = strtok(NULL, delims);
-                  p->arrival = atoi(token);
-               }
-               else if (strcmp(token, "burst") == 0)
-               {
-                  token = strtok(NULL, delims);
-                  p->burst = atoi(token);
-               }
-               // Handle error
-               else
-               {
-                  printf("Invalid scheduling type");
-               }
-               token = strtok(NULL, delims);
-            }
-         }
-         // Handle error.
-         else
-         {
-            printf("Invalid token");
-            break;
-         }
-
-         token = strtok(NULL, delims);
+         resume = 1;
       }
-   }
-
-   fclose(inputFile);
-}
-
-// Print basic information about the data that is about to be processed.
-void printConfiguration()
-{
-   char quantumStatement[50];
-   sprintf(quantumStatement, "Quantum %d\n\n", quantum);
-   fprintf(outputFile, "%d processes\n", processCount);
-   fprintf(outputFile, "Using %s\n%s", schedulerTypeString[schedulerType],
-           (RoundRobin == schedulerType) ? (quantumStatement) : ("\n"));
-}
-
-/** Standard prints used in each algorithm **/
-void setProcessArrived(int time, process* p)
-{
-   p->isReady = TRUE;
-   p->startTime = time;
-   fprintf(outputFile, "Time %d: %s arrived\n", time, p->name);
-}
-
-void printProcessSelected(int time, process* p)
-{
-   fprintf(outputFile, "Time %d: %s selected (burst %d)\n", time, p->name, p->burst);
-}
-
-void setProcessFinished(int time, process* p)
-{
-   p->isReady = FALSE;
-   p->endTime = time;
-   fprintf(outputFile, "Time %d: %s finished\n", time, p->name);
-}
-
-void printIdle(int time)
-{
-   fprintf(outputFile, "Time %d: IDLE\n", time);
-}
-
-void printSchedulerFinished(int time)
-{
-   fprintf(outputFile, "Finished at time %d\n\n", time);
-}
-
-void printProcessStats(process* processArray, int count)
-{
-   int i;
-   for (i = 0; i < count; i++)
-   {
-      if(processArray[i].endTime > 0)
-         fprintf(outputFile, "%s wait %d turnaround %d\n", processArray[i].name,
-                                                           processArray[i].wait,
-                                                           processArray[i].endTime - processArray[i].startTime);
-      else
-         fprintf(outputFile, "%s didn't finish\n", processArray[i].name);
-   }
-
-}
-
-/** Scheduling algorithms **/
-void runFCFS()
-{
-   int idxOfCurrent = -1;
-
-   // Iterate through each time slot of the total runtime.
-   int time;
-   for (time = 0; time < runtime; time++)
-   {
-      // Determine if current process has finished.
-      if ((-1 != idxOfCurrent) && (0 == processes[idxOfCurrent].burst))
+      else if ((i + 1 < argc) && (0 == strcmp(argv[i], METRICS_OPTION)))
       {
-         setProcessFinished(time, &processes[idxOfCurrent]);
-         idxOfCurrent = -1;
+         metricsFile = argv[++i];
       }
-
-      int idxOfSelected = -1;
-      int minArrival = MAX_INT;
-
-      // Iterate through all the processes.
-      int i;
-      for (i = 0; i < processCount; i++)
+      else if ((i + 1 < argc) && (0 == strcmp(argv[i], CHECKPOINT_OPTION)))
       {
-         // Determine if a process arrives at this time.
-         if (time == processes[i].arrival)
-         {
-            setProcessArrived(time, &processes[i]);
-         }
-
-         // Out of ready processes, select the any that arrive first.
-         if (processes[i].isReady && (processes[i].arrival < minArrival))
-         {
-            idxOfSelected = i;
-            minArrival = processes[i].arrival;
-         }
+         checkpointFile = argv[++i];
       }
-
-      // Update the wait times of ready processes that were not selected.
-      for (i = 0; i < processCount; i++)
+      else if ((i + 1 < argc) && (0 == strcmp(argv[i], WHAT_IF_OPTION)))
       {
-         if (processes[i].isReady && (i != idxOfSelected))
-         {
-            processes[i].wait++;
-         }
-      }
-
-      // Only log the selection if the process is not currently running.
-      if (idxOfSelected != idxOfCurrent)
-      {
-         idxOfCurrent = idxOfSelected;
-         printProcessSelected(time, &processes[idxOfCurrent]);
-      }
-
-      // Update the remaining burst time of current process.
-      if (-1 != idxOfCurrent)
-      {
-         processes[idxOfCurrent].burst--;
+         whatIfFile = argv[++i];
       }
       else
       {
-         printIdle(time);
+         fprintf(stderr, "Usage: %s [%s] [%s] [%s] [%s <metrics file>] [%s <checkpoint file> [%s]] [%s <changes file>] | %s <input file or directory>...\n",
+                 argv[0], STREAM_OPTION, SUMMARY_OPTION, BINARY_OPTION, METRICS_OPTION, CHECKPOINT_OPTION,
+                 RESUME_OPTION, WHAT_IF_OPTION, BATCH_OPTION);
+         return -1;
       }
    }
 
-    // Determine if current process has finished.
-    // For when the process happens to finish at the last tick.
-   if ((-1 != idxOfCurrent) && (0 == processes[idxOfCurrent].burst))
+   if (resume && (NULL == checkpointFile))
    {
-      setProcessFinished(time, &processes[idxOfCurrent]);
-      idxOfCurrent = -1;
+      fprintf(stderr, "%s needs %s <checkpoint file>\n", RESUME_OPTION, CHECKPOINT_OPTION);
+      return -1;
    }
 
-   printSchedulerFinished(time);
-   printProcessStats(processes, processCount);
-}
-
-// Implementation of the pre-emptive shortest job first scheduling algorithm.
-// It is Inefficient because processes are not stored in a data structure
-// that maintains ordering based on burst time.
-void runSJF()
-{
-   int idxOfCurrent = -1;
+   scheduler* s = createScheduler();
+   int result = 0;
+   setSchedulerSummaryOnly(s, summaryOnly);
+   setSchedulerBinaryTrace(s, binaryTrace);
+   if (NULL != whatIfFile)
+   {
+      setSchedulerSnapshots(s, SNAPSHOT_COUNT);
+   }
 
-   // Iterate through each time slot of the total runtime.
-   int time;
-   for (time = 0; time < runtime; time++)
+   if (NULL != metricsFile)
    {
-      // Determine if current process has finished.
-      if ((-1 != idxOfCurrent) && (0 == processes[idxOfCurrent].burst))
-      {
-         setProcessFinished(time, &processes[idxOfCurrent]);
-         idxOfCurrent = -1;
-      }
+      size_t length = strlen(metricsFile);
+      int csv = (length >= strlen(CSV_SUFFIX)) &&
+                (0 == strcmp(metricsFile + length - strlen(CSV_SUFFIX), CSV_SUFFIX));
+      result = setSchedulerMetricsFile(s, metricsFile, csv ? MetricsCsv : MetricsJson);
+   }
 
-      int idxOfSelected = -1;
-      int minBurst = MAX_INT;
+   // A resumed run keeps part of its output, so this goes before the output.
+   if ((0 == result) && (NULL != checkpointFile))
+   {
+      result = setSchedulerCheckpoint(s, checkpointFile, resume);
+   }
 
-      // Iterate through all the processes.
-      int i;
-      for (i = 0; i < processCount; i++)
+   if ((0 == result) && streaming)
+   {
+      result = setSchedulerOutputFd(s, STDOUT_FILENO);
+      if (0 == result)
       {
-         // Determine if a process arrives at this time.
-         if (time == processes[i].arrival)
-         {
-            setProcessArrived(time, &processes[i]);
-         }
-
-         // Out of ready processes, select the one that has shortest current burst time.
-         if (processes[i].isReady && (processes[i].burst < minBurst))
-         {
-            idxOfSelected = i;
-            minBurst = processes[i].burst;
-         }
+         result = loadSchedulerStream(s, STDIN_FILENO);
       }
-
-      // Update the wait times of ready processes that were not selected.
-      for (i = 0; i < processCount; i++)
+   }
+   else if (0 == result)
+   {
+      // Open the output file for writing.
+      // This should be done before anything else.
+      result = setSchedulerOutputFile(s, binaryTrace ? TRACE_FILE_NAME : OUTPUT_FILE_NAME);
+      if (0 == result)
       {
-         if (processes[i].isReady && (i != idxOfSelected))
-         {
-            processes[i].wait++;
-         }
+         result = loadScheduler(s, INPUT_FILE_NAME);
       }
+   }
 
-      // Only log the selection if the process is not currently running.
-      if (idxOfSelected != idxOfCurrent)
-      {
-         idxOfCurrent = idxOfSelected;
-         printProcessSelected(time, &processes[idxOfCurrent]);
-      }
+   if (0 == result)
+   {
+      result = runScheduler(s);
+   }
 
-      // Update the remaining burst time of current process.
-      if (-1 != idxOfCurrent)
-      {
-         processes[idxOfCurrent].burst--;
-      }
-      else
-      {
-         printIdle(time);
-      }
+   if ((0 == result) && (NULL != whatIfFile))
+   {
+      result = runWhatIfs(s, whatIfFile);
    }
 
-  // Determine if current process has finished.
-  // For when the process happens to finish at the last tick.
-  if ((-1 != idxOfCurrent) && (0 == processes[idxOfCurrent].burst))
-  {
-     setProcessFinished(time, &processes[idxOfCurrent]);
-     idxOfCurrent = -1;
-  }
+   destroyScheduler(s);
 
-   printSchedulerFinished(time);
-   printProcessStats(processes, processCount);
+   return result;
 }
 
-// Round Robin scheduling algorithm.
-void runRR()
+// Each line names a process, then optionally "arrival" and "burst" with
+// their new values.
+int runWhatIfs(scheduler* s, const char* fileName)
 {
-   int i, time;
-   int idxOfCurrent = -1;
-   integerQueue readyQueue;
-   int quantumRemaining = 0;
-   BOOL processFinished = TRUE;
-
-   createQueue(&readyQueue, processCount);
+   FILE* f = fopen(fileName, "r");
+   if (NULL == f)
+   {
+      fprintf(stderr, "Can't open changes file %s\n", fileName);
+      return -1;
+   }
 
-   // Iterate through each time slot of the total runtime.
-   for (time = 0; time < runtime; time++)
+   char line[WHAT_IF_LINE_LENGTH];
+   int lineNumber = 0;
+   int result = 0;
+   while ((0 == result) && (NULL != fgets(line, sizeof(line), f)))
    {
-      // Check if the current process has finished all of its work
-      if ((idxOfCurrent != -1) && (processes[idxOfCurrent].burst == 0))
+      lineNumber++;
+      char* name = strtok(line, " \t\r\n");
+      if (NULL == name)
       {
-         setProcessFinished(time, &processes[idxOfCurrent]);
-         processFinished = TRUE;
-         idxOfCurrent = -1;
+         continue;
       }
 
-      // Enqueue process if it ran out of quantum but still has work to do
-      if (!quantumRemaining && !processFinished)
+      long long arrival = -1;
+      long long burst = -1;
+      char* key;
+      while ((0 == result) && (NULL != (key = strtok(NULL, " \t\r\n"))))
       {
-         if(!enqueue(&readyQueue, idxOfCurrent))
+         char* value = strtok(NULL, " \t\r\n");
+         char* end = NULL;
+         long long number = (NULL != value) ? strtoll(value, &end, 10) : -1;
+         if ((NULL == value) || ('\0' != *end) || (number < 0))
          {
-            fprintf(stderr, "Queue is full. Cannot enqueue idx %d\n", idxOfCurrent);
+            result = -1;
          }
-      }
-
-      // Enqueue newly arrived processes
-      for (i = 0; i < processCount; i++)
-      {
-         if (time == processes[i].arrival)
+         else if (0 == strcmp(key, "arrival"))
          {
-            setProcessArrived(time, &processes[i]);
-            
-            if(!enqueue(&readyQueue, i))
-            {
-               fprintf(stderr, "Queue is full. Cannot enqueue idx %d\n", i);
-            }
+            arrival = number;
          }
-      }
-
-      // Dequeue next process if the current one is out of time or finished
-      if (!quantumRemaining || processFinished)
-      {
-         idxOfCurrent = dequeue(&readyQueue);
-
-         if (idxOfCurrent != -1)
+         else if (0 == strcmp(key, "burst"))
          {
-            printProcessSelected(time, &processes[idxOfCurrent]);
-            processFinished = FALSE;
+            burst = number;
+         }
+         else
+         {
+            result = -1;
          }
-
-         quantumRemaining = quantum;
       }
 
-      // Update the burst time and quantum remaining of current process.
-      if (idxOfCurrent != -1)
-      {
-         processes[idxOfCurrent].burst--;
-         quantumRemaining--;
-      }
-      else // Enter idle
+      int process = findSchedulerProcess(s, name);
+      if ((0 != result) || (process < 0))
       {
-         printIdle(time);
+         fprintf(stderr, "Line %d of %s isn't a process and its new arrival or burst\n", lineNumber, fileName);
+         result = -1;
       }
-
-      // Update the wait times of ready processes that were not selected.
-      for (i = 0; i < processCount; i++)
+      else
       {
-         if (processes[i].isReady && (i != idxOfCurrent))
-         {
-            processes[i].wait++;
-         }
+         result = whatIfScheduler(s, process, arrival, burst, STDOUT_FILENO, NULL);
       }
    }
 
-   // Check for a process that finished at end of runtime
-   if ((idxOfCurrent != -1) && (processes[idxOfCurrent].burst == 0))
-   {
-      setProcessFinished(time, &processes[idxOfCurrent]);
-   }
-
-   printSchedulerFinished(time);
-   printProcessStats(processes, processCount);
-
-   destroyQueue(&readyQueue);
-}
-
-void createQueue(integerQueue *q, int capacity)
-{
-   q->array = calloc(capacity, sizeof(int));
-   q->head = q->tail = -1;
-   q->capacity = capacity;
-}
-
-void destroyQueue(integerQueue *q)
-{
-   free(q->array);
-   q->head = q->tail = -1;
-   q->capacity = 0;
-}
-
-BOOL isEmpty(integerQueue *q)
-{
-   return (q->head == q->tail);
-}
-
-BOOL isFull(integerQueue *q)
-{
-   return (q->head == (q->tail - q->capacity));
-}
-
-BOOL enqueue(integerQueue *q, int val)
-{
-   if (isFull(q))
-   {
-      return FALSE;
-   }
-
-   q->tail++;
-   q->array[q->tail % q->capacity] = val;
-
-   return TRUE;
+   fclose(f);
+   return result;
 }
-
-int dequeue(integerQueue *q)
-{
-   if (isEmpty(q))
-   {
-      return -1;
-   }
-
-   q->head++;
-   return (q->array[q->head % q->capacity]);
-}
\ No newline at end of file
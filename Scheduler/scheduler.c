@@ -0,0 +1,5212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "scheduler.h"
+#include "trace.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define STREAM_BUFFER_SIZE (1 << 16)
+#define BOOL int
+#define TRUE 1
+#define FALSE 0
+#define MAX_INT 2147483647
+#define ARRIVAL_TIMER(s) ((s)->cpuCount)
+#define POLICY_TIMER(s) ((s)->cpuCount + 1)
+#define IO_TIMER(s, idx) ((s)->cpuCount + 2 + (idx))
+#define DEPTH_BUCKETS 64
+#define MAX_LEVELS 64
+#define DEFAULT_LEVELS 3
+#define DEFAULT_WEIGHT 1024
+#define VRUNTIME_SCALE (1 << 20)
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 11
+#define CHECKPOINT_MAGIC "SCHEDCKP"
+#define CHECKPOINT_MAGIC_LENGTH 8
+#define CHECKPOINT_VERSION 2
+// Seconds between checkpoints, and events between looks at the clock.
+#define CHECKPOINT_INTERVAL 5
+#define CHECKPOINT_CHECK_EVENTS 4096
+#define HASH_OFFSET 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
+
+/** Datatypes **/
+// Scheduler type enum declaration (and corresponding string arrays)
+// Based on code from this source: https://goo.gl/eAU4bo
+// Each policy is listed with the prefix of its hooks, which is also the
+// keyword that selects it with "use". Adding a policy takes a line here
+// and its hooks; its driver loop is generated from them.
+#define foreach_schedulerType(schedulerType) \
+        schedulerType(FirstComeFirstServed, fcfs)   \
+        schedulerType(ShortestJobFirst, sjf)  \
+        schedulerType(RoundRobin, rr) \
+        schedulerType(MultilevelFeedbackQueue, mlfq) \
+        schedulerType(CompletelyFair, cfs) \
+
+#define GENERATE_ENUM(ENUM, PREFIX) ENUM,
+#define GENERATE_STRING(STRING, PREFIX) #STRING,
+#define GENERATE_KEYWORD(ENUM, PREFIX) #PREFIX,
+#define GENERATE_PROTOTYPE(ENUM, PREFIX) void run##ENUM(scheduler* s);
+#define GENERATE_DISPATCH(ENUM, PREFIX) case ENUM: run##ENUM(s); break;
+
+typedef enum {
+    foreach_schedulerType(GENERATE_ENUM)
+} schedulerTypeEnum;
+
+static const char *schedulerTypeString[] = {
+    foreach_schedulerType(GENERATE_STRING)
+};
+
+static const char *schedulerTypeKeyword[] = {
+    foreach_schedulerType(GENERATE_KEYWORD)
+};
+
+// Keywords understood by the input parser.
+typedef enum
+{
+   KeywordUnknown,
+   KeywordComment,
+   KeywordEnd,
+   KeywordProcessCount,
+   KeywordRunFor,
+   KeywordUse,
+   KeywordQuantum,
+   KeywordCpus,
+   KeywordProcess,
+   KeywordName,
+   KeywordArrival,
+   KeywordBurst,
+   KeywordWeight,
+   KeywordLevels,
+   KeywordQuanta,
+   KeywordBoost,
+   KeywordIo
+} keywordEnum;
+
+// Process index with the key it is sorted by.
+typedef struct
+{
+   long long key;
+   int idx;
+} sortEntry;
+
+// A token is a span of the memory-mapped input file. It is not terminated.
+typedef struct
+{
+   const char* start;
+   int length;
+} token;
+
+// One process as it is read from a line of input.
+typedef struct
+{
+   // Points into the memory-mapped input file, or to a copy of the name
+   // owned by the process in streaming mode.
+   const char* name;
+   int nameLength;
+   // Position of the process in the input.
+   int order;
+   long long arrival;
+   long long burst;
+   // Share of the CPU under CFS, relative to DEFAULT_WEIGHT. 0 if not given.
+   int weight;
+   // I/O waits and the CPU bursts after them, in pairs, after the first
+   // burst, or NULL for a process without I/O. Owned by the process.
+   long long* cycles;
+   int cycleCount;
+} process;
+
+// The table of processes, with one array per field. The fields the event
+// loop reads are packed tightly, so scanning one of them only touches the
+// cache lines holding that field. Names are only needed to print and are
+// kept apart from them.
+// The table is never changed by a run, so several runs can share it. What a
+// run changes is kept in the runState of each scheduler.
+typedef struct
+{
+   long long* arrival;
+   long long* burst;
+   int* order;
+   int* weight;
+   const char** name;
+   int* nameLength;
+   // The I/O cycles of each process. Only allocated once a process has some.
+   long long** cycles;
+   int* cycleCount;
+   int capacity;
+} processTable;
+
+// Links of a ready process in a red-black tree, by process index, or -1.
+// A process is in at most one tree at a time, so each process needs only
+// one set of links.
+typedef struct
+{
+   int left;
+   int right;
+   int parent;
+   BOOL red;
+} treeLink;
+
+// What a run changes about each process, indexed like the process table.
+// A process waits for every tick between its arrival and completion in
+// which it is not running, so its wait time follows from endTime alone.
+typedef struct
+{
+   // Burst time the process still has to run.
+   long long* remaining;
+   // Time the process finished, or 0 if it hasn't.
+   long long* endTime;
+   // Queue level of each process, only kept for a multilevel feedback queue.
+   int* level;
+   // Number of I/O cycles each process has started, only kept when the
+   // processes have I/O.
+   int* cycle;
+   // Virtual runtime of each process and its links in the tree of ready
+   // processes of its core, only kept for CFS.
+   long long* vruntime;
+   treeLink* links;
+} runState;
+
+// Integer queue for round robin scheduling by process index. It is a ring
+// with a power of two capacity, so positions wrap with a mask. Head and
+// tail only count up, wrapping around together, and the queue holds the
+// processes from head up to tail.
+typedef struct
+{
+   int *array;
+   unsigned int head;
+   unsigned int tail;
+   unsigned int mask;
+} integerQueue;
+
+// Binary min-heap of process indices for shortest job first scheduling.
+// Processes are ordered by remaining burst time, then by input order.
+// A process doesn't run while it is in the heap, so its key is stored
+// alongside it and the heap never has to look at the process table.
+typedef struct
+{
+   long long burst;
+   int order;
+   int idx;
+} heapEntry;
+
+typedef struct
+{
+   heapEntry *array;
+   int size;
+   int capacity;
+} burstHeap;
+
+// Red-black tree of ready processes for CFS, ordered by virtual runtime,
+// then by input order. The leftmost process is cached since it is the one
+// that runs next.
+typedef struct
+{
+   int root;
+   int leftmost;
+   int size;
+} readyTree;
+
+// Hierarchical timing wheel of pending events. Each event is a timer with a
+// small integer id. Level l has a slot for each value of bits 6l to 6l + 5
+// of a time, and a timer goes in the highest level whose bits of its time
+// differ from the time of the wheel, so a lower level only holds earlier
+// timers. Once the wheel reaches the slot of a timer on a higher level, the
+// timer cascades down to the level of the bits it still differs in.
+// Each slot lists its timers in the order they were scheduled.
+typedef struct
+{
+   long long now;
+   // Per timer: when it goes off, its neighbours in its slot, and its slot,
+   // or -1 while it isn't pending.
+   long long* when;
+   int* next;
+   int* prev;
+   int* slot;
+   int capacity;
+   int first[WHEEL_LEVELS * WHEEL_SLOTS];
+   int last[WHEEL_LEVELS * WHEEL_SLOTS];
+   // Bit k of occupied[l] is set when slot k of level l holds a timer.
+   unsigned long long occupied[WHEEL_LEVELS];
+} timerWheel;
+
+// State of one simulated CPU core. Each core has its own ready processes,
+// kept in whichever structure its policy uses: a FIFO queue for FCFS and
+// RR, a burst-ordered heap for SJF, a FIFO queue per level for MLFQ and a
+// tree ordered by virtual runtime for CFS.
+typedef struct
+{
+   int id;
+   int idxOfCurrent;
+   // Input order of the last process this core ran, to count context switches.
+   int lastOrder;
+   // Only counts down to the end of a time slice with a time sliced policy.
+   long long quantumRemaining;
+   integerQueue readyQueue;
+   burstHeap readyHeap;
+   // Bit l of levelMask is set when level l has ready processes, so the
+   // highest non-empty level is its lowest set bit.
+   integerQueue* levelQueues;
+   unsigned long long levelMask;
+   int levelReady;
+   readyTree tree;
+   // Virtual runtime that processes joining this core start from, so they
+   // don't run ahead of the processes already there.
+   long long minVruntime;
+   long long busyTime;
+} cpuCore;
+
+// Metrics of a run, collected only when a metrics file is set.
+typedef struct
+{
+   // Time spent with each number of ready processes, over all cores, in
+   // power of two buckets: 0, 1, 2-3, 4-7 and so on.
+   long long depthTime[DEPTH_BUCKETS];
+   long long depthArea;
+   long long maxDepth;
+   // Wait and turnaround of each finished process, for the percentiles.
+   long long* waits;
+   long long* turnarounds;
+   int sampleCount;
+   int sampleCapacity;
+   struct timespec startTime;
+} runMetrics;
+
+// Output stage for the trace. Text is formatted by hand into a large buffer
+// that is handed to the kernel in big write() calls.
+typedef struct
+{
+   int fd;
+   BOOL ownsFd;
+   char *buffer;
+   int length;
+} outputWriter;
+
+// Line reader for streaming mode. Unconsumed input is kept between
+// start and end of the buffer, which grows to fit long lines.
+typedef struct
+{
+   int fd;
+   char *buffer;
+   int start;
+   int end;
+   int capacity;
+   BOOL atEnd;
+} streamReader;
+
+// A checkpoint as it is built in memory before it is written out, or as
+// it is read back. Numbers are varints, as in the binary trace.
+typedef struct
+{
+   unsigned char* data;
+   size_t length;
+   size_t capacity;
+   size_t position;
+   // Set when reading goes past the end or memory runs out.
+   BOOL failed;
+} checkpointBuffer;
+
+// Periodic checkpoints of a run. Finished processes never change again, so
+// they are appended to a log as they finish and each checkpoint only adds
+// the ones since the last. What can still change, the cores and the
+// processes that are alive, goes into a small state file that replaces the
+// last one at once and tells how much of the log and of the output it
+// covers. Anything written after that is dropped when the run is resumed.
+typedef struct
+{
+   // The state file, the log of finished processes next to it, and the
+   // file a new state is written to before it replaces the last one.
+   char* fileName;
+   char* logName;
+   char* tempName;
+   BOOL resume;
+   // The log while checkpoints are being written, or -1.
+   int logFd;
+   long long logLength;
+   // Records of the processes that finished since the last checkpoint,
+   // ready to go to the end of the log.
+   checkpointBuffer finished;
+   // Hash of the processes and settings, which a resumed run must share.
+   unsigned long long fingerprint;
+   struct timespec lastWrite;
+   int countdown;
+   checkpointBuffer buffer;
+} checkpointState;
+
+// A state of a run kept in memory, and how much of the log of finished
+// processes it covers.
+typedef struct
+{
+   long long time;
+   long long logLength;
+   checkpointBuffer state;
+} runSnapshot;
+
+// Snapshots of a run for what-if runs to start from, taken every interval
+// of simulated time. They share one log of finished processes, like
+// checkpoints do. A what-if run only has the snapshot it starts from and a
+// view of the log up to it.
+typedef struct
+{
+   long long interval;
+   long long nextTime;
+   runSnapshot* list;
+   int count;
+   int capacity;
+   checkpointBuffer log;
+   runSnapshot* from;
+} snapshotState;
+
+/** Prototypes **/
+int parseInputFile(scheduler* s, const char* fileName);
+void parseInput(scheduler* s, const char* data, size_t size);
+void releaseInputFile(scheduler* s);
+BOOL parseLine(scheduler* s, const char* cursor, const char* lineEnd, process* p);
+void parseProcess(const char* cursor, const char* lineEnd, process* p);
+BOOL nextToken(const char** cursor, const char* lineEnd, token* t);
+long long parseNumber(const char** cursor, const char* lineEnd);
+void parseQuantum(scheduler* s, token* t);
+long long tokenToNumber(const char* c, const char* end);
+keywordEnum lookupKeyword(token* t);
+void sortProcesses(int* indices, const long long* keys, int count);
+void buildArrivalOrder(scheduler* s);
+void parseQuanta(scheduler* s, const char** cursor, const char* lineEnd);
+int setupLevels(scheduler* s);
+void printConfiguration(scheduler* s);
+void printProcessStats(scheduler* s, process* p, long long endTime);
+void addCycleTimes(process* p, long long* cpuTime, long long* ioTime);
+void printFinalStats(scheduler* s);
+void printAggregateStats(scheduler* s);
+
+void parseStreamHeader(scheduler* s, int fd);
+BOOL readStreamLine(scheduler* s, const char** lineStart, const char** lineEnd);
+BOOL peekStreamProcess(scheduler* s);
+int nextStreamArrival(scheduler* s, long long time);
+int allocateProcess(scheduler* s);
+void releaseProcess(scheduler* s, int idx);
+void createRunState(scheduler* s);
+void destroyRunState(scheduler* s);
+void resizeProcessTable(processTable* table, int oldCapacity, int capacity);
+void destroyProcessTable(processTable* table);
+void storeProcess(processTable* table, int idx, process* p);
+process loadProcess(processTable* table, int idx);
+void runSweep(scheduler* s);
+void* runSweepWorker(void* arg);
+void printSweepTable(scheduler* s, scheduler* runs, int runCount);
+foreach_schedulerType(GENERATE_PROTOTYPE)
+void runPolicy(scheduler* s);
+int nextArrivingProcess(scheduler* s, long long time, int* cursor);
+int countArrivals(scheduler* s, long long time, int* cursor);
+long long findNextArrival(scheduler* s, int cursor);
+void setTimer(scheduler* s, int id, long long when);
+void setCoreTimer(scheduler* s, cpuCore* core, long long time, BOOL timeSliced);
+void expireTimers(scheduler* s, long long time);
+void setProcessStartedIo(scheduler* s, long long time, int idx, cpuCore* core);
+void scheduleIo(scheduler* s, int idx, long long when);
+void printProcessFinishedIo(scheduler* s, long long time, int idx);
+long long fastForwardLoneProcess(scheduler* s, long long time, int arrivalCursor);
+void advanceTime(scheduler* s, long long time, long long nextEvent);
+
+void createCores(scheduler* s);
+void destroyCores(scheduler* s);
+int readyCount(cpuCore* core);
+int surplusCount(cpuCore* core, BOOL timeSliced);
+void finishProcesses(scheduler* s, long long time);
+cpuCore* leastLoadedCore(scheduler* s);
+cpuCore* findStealVictim(scheduler* s, BOOL timeSliced);
+void finishSimulation(scheduler* s, long long time);
+
+BOOL isFull(integerQueue *q);
+BOOL isEmpty(integerQueue *q);
+BOOL contains(integerQueue *q, int key);
+int queueCount(integerQueue *q);
+void createQueue(integerQueue *q, int capacity);
+void destroyQueue(integerQueue *q);
+BOOL growQueue(integerQueue *q, unsigned int capacity);
+BOOL enqueue(integerQueue *q, int val);
+BOOL enqueueAll(integerQueue *q, const int *vals, int count);
+int dequeue(integerQueue *q);
+
+BOOL isShorterJob(heapEntry *a, heapEntry *b);
+BOOL isHeapEmpty(burstHeap *h);
+void createHeap(burstHeap *h, int capacity);
+void destroyHeap(burstHeap *h);
+void heapPush(burstHeap *h, int idx, long long burst, int order);
+heapEntry *heapPeek(burstHeap *h);
+int heapPop(burstHeap *h);
+
+BOOL isBeforeInTree(scheduler* s, int a, int b);
+void treeInsert(scheduler* s, readyTree* t, int idx);
+int treePopMin(scheduler* s, readyTree* t);
+void rotateLeft(scheduler* s, readyTree* t, int x);
+void rotateRight(scheduler* s, readyTree* t, int x);
+int treeNext(scheduler* s, int idx);
+
+void createWheel(timerWheel* w, int capacity);
+void destroyWheel(timerWheel* w);
+void wheelLink(timerWheel* w, int id);
+void wheelUnlink(timerWheel* w, int id);
+void wheelSchedule(timerWheel* w, int id, long long when);
+void wheelCancel(timerWheel* w, int id);
+BOOL growWheel(timerWheel* w, int capacity);
+long long wheelPeek(timerWheel* w, long long limit);
+long long wheelNextBefore(timerWheel* w, long long limit);
+int wheelPop(timerWheel* w, long long time);
+
+int openOutput(scheduler* s, const char* fileName);
+void attachOutput(scheduler* s, int fd, BOOL ownsFd);
+void closeOutput(scheduler* s);
+void flushOutput(scheduler* s);
+void writeAll(scheduler* s, const char* data, int size);
+void writeBytes(scheduler* s, const char* data, int size);
+void writeString(scheduler* s, const char* str);
+void writeInt(scheduler* s, long long val);
+void writeByte(scheduler* s, int val);
+void writeVarint(scheduler* s, unsigned long long val);
+void writeSignedVarint(scheduler* s, long long val);
+void writeTraceRecord(scheduler* s, traceRecordType type, long long time);
+void writeTraceCpu(scheduler* s, cpuCore* core);
+void writeTraceHeader(scheduler* s);
+void writeTraceNames(scheduler* s);
+void writeTraceName(scheduler* s, int order, const char* name, int nameLength);
+void writeTraceIdle(scheduler* s, long long time, long long ticks);
+
+void recordQueueDepth(scheduler* s, long long elapsed);
+void recordProcessFinished(scheduler* s, long long wait, long long turnaround);
+void writeMetrics(scheduler* s, long long time);
+void writeJsonMetrics(scheduler* s, FILE* f, long long time);
+void writeCsvMetrics(scheduler* s, FILE* f, long long time);
+int compareTimes(const void* a, const void* b);
+long long percentile(long long* sorted, int count, int percent);
+double averageOf(long long total, long long count);
+double elapsedSince(struct timespec* start);
+
+int openCheckpoint(scheduler* s);
+void closeCheckpoint(scheduler* s);
+void noteProcessFinished(checkpointBuffer* log, int idx, long long time);
+void checkpointIfDue(scheduler* s, long long time, int arrivalCursor);
+void writeCheckpoint(scheduler* s, long long time, int arrivalCursor);
+long long restoreCheckpoint(scheduler* s, int* arrivalCursor);
+void saveRunState(scheduler* s, checkpointBuffer* b, long long time, int arrivalCursor);
+long long loadRunState(scheduler* s, checkpointBuffer* b, int* arrivalCursor);
+BOOL readCheckpointLog(scheduler* s, long long length);
+BOOL applyFinishLog(scheduler* s, checkpointBuffer* log);
+unsigned long long fingerprintRun(scheduler* s);
+unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size);
+unsigned long long hashNumber(unsigned long long hash, long long val);
+BOOL readWholeFile(const char* fileName, checkpointBuffer* b);
+BOOL writeWholeFile(int fd, const unsigned char* data, size_t size);
+void putCheckpointBytes(checkpointBuffer* b, const void* data, size_t size);
+void putCheckpointVarint(checkpointBuffer* b, unsigned long long val);
+void putCheckpointSigned(checkpointBuffer* b, long long val);
+unsigned long long getCheckpointVarint(checkpointBuffer* b);
+long long getCheckpointSigned(checkpointBuffer* b);
+void putProcessState(scheduler* s, checkpointBuffer* b, int idx);
+int getProcessState(scheduler* s, checkpointBuffer* b);
+
+void takeSnapshot(scheduler* s, long long time, int arrivalCursor);
+void destroySnapshots(scheduler* s);
+void moveProcess(scheduler* s, int idx, long long arrival, long long burst);
+void printOutcome(FILE* f, process* p, long long endTime);
+void printWhatIfSummary(FILE* f, const char* label, schedulerSummary* summary);
+
+/** Scheduler context **/
+// Everything a simulation needs lives here, so that any number of
+// simulations can exist side by side.
+struct scheduler
+{
+   int processCount;
+   processTable processes;
+   // Process indices sorted by arrival time, then by input order, and the
+   // arrival time of each, so the schedulers can walk arrivals in order.
+   int* arrivalOrder;
+   long long* arrivalTimes;
+   // The input file stays mapped while the simulation runs, since the process
+   // names point into it.
+   char* inputData;
+   size_t inputSize;
+   long long runtime;
+   schedulerTypeEnum schedulerType;
+   long long quantum;
+   // Multilevel feedback queue: the number of levels, the quantum of each
+   // level as given and filled in by setupLevels(), and how often every
+   // process goes back to the top level, or 0 for never.
+   int levelCount;
+   long long levelQuanta[MAX_LEVELS];
+   int levelQuantaCount;
+   long long boostPeriod;
+   // Last quantum of a sweep over quantum to sweepLast, or 0 for a single run.
+   long long sweepLast;
+   runState state;
+   outputWriter output;
+   // A silent run doesn't write anything. It is only after the summary.
+   BOOL silent;
+   // A summary-only run is silent until the end, then writes when it
+   // finished and the aggregate stats instead of a trace.
+   BOOL summaryOnly;
+   // Write the binary trace of trace.h instead of text, and the time of
+   // the last timed record it holds.
+   BOOL binaryTrace;
+   long long traceTime;
+   // Number of simulated CPU cores, each with its own run queue.
+   int cpuCount;
+   cpuCore* cores;
+   // Pending events: the time the process of each core finishes or runs
+   // out of quantum, by core id, then the next arrival, the next event of
+   // the policy, and the end of the I/O of each blocked process, by index.
+   timerWheel timers;
+   // Processes whose I/O is done at the current event, in the order their
+   // timers went off.
+   integerQueue waking;
+
+   // In streaming mode processes are read from a file descriptor as the
+   // simulation reaches their arrival and finished processes are freed.
+   // Processes then live in a pool of slots that is only as large as the
+   // number of processes that are alive at the same time.
+   BOOL streaming;
+   streamReader streamInput;
+   // The next process of the stream, read ahead to know when it arrives.
+   process pendingProcess;
+   BOOL hasPendingProcess;
+   int streamProcessesRead;
+   int poolCapacity;
+   int* freeSlots;
+   int freeSlotCount;
+
+   // Aggregate results, filled in as processes finish.
+   schedulerSummary summary;
+   FILE* metricsFile;
+   schedulerMetricsFormat metricsFormat;
+   runMetrics metrics;
+   checkpointState checkpoint;
+   // Snapshots wanted over the run, and the snapshots taken.
+   int snapshotCount;
+   snapshotState snapshots;
+
+   // Set when reading the input or writing the trace fails.
+   BOOL failed;
+};
+
+/** Library interface **/
+scheduler* createScheduler()
+{
+   scheduler* s = calloc(1, sizeof(scheduler));
+   if (NULL != s)
+   {
+      s->output.fd = -1;
+      s->streamInput.fd = -1;
+      s->checkpoint.logFd = -1;
+   }
+
+   return s;
+}
+
+void destroyScheduler(scheduler* s)
+{
+   if (NULL == s)
+   {
+      return;
+   }
+
+   // Close the output file and free memory used for the processes.
+   closeOutput(s);
+   if (s->streaming)
+   {
+      int i;
+      for (i = 0; i < s->poolCapacity; i++)
+      {
+         free((char*) s->processes.name[i]);
+      }
+      if (s->hasPendingProcess)
+      {
+         free((char*) s->pendingProcess.name);
+         free(s->pendingProcess.cycles);
+      }
+   }
+   destroyProcessTable(&s->processes);
+   destroyRunState(s);
+   free(s->arrivalOrder);
+   free(s->arrivalTimes);
+   free(s->metrics.waits);
+   free(s->metrics.turnarounds);
+   if (NULL != s->metricsFile)
+   {
+      fclose(s->metricsFile);
+   }
+   free(s->freeSlots);
+   free(s->streamInput.buffer);
+   closeCheckpoint(s);
+   destroySnapshots(s);
+   free(s->checkpoint.fileName);
+   free(s->checkpoint.logName);
+   free(s->checkpoint.tempName);
+   releaseInputFile(s);
+   free(s);
+}
+
+int setSchedulerOutputFile(scheduler* s, const char* fileName)
+{
+   return openOutput(s, fileName);
+}
+
+int setSchedulerOutputFd(scheduler* s, int fd)
+{
+   attachOutput(s, fd, FALSE);
+   return 0;
+}
+
+int setSchedulerMetricsFile(scheduler* s, const char* fileName, schedulerMetricsFormat format)
+{
+   s->metricsFile = fopen(fileName, "w");
+   if (NULL == s->metricsFile)
+   {
+      fprintf(stderr, "Can't open metrics file %s\n", fileName);
+      return -1;
+   }
+
+   s->metricsFormat = format;
+   return 0;
+}
+
+void setSchedulerSummaryOnly(scheduler* s, int summaryOnly)
+{
+   s->summaryOnly = summaryOnly;
+}
+
+void setSchedulerBinaryTrace(scheduler* s, int binaryTrace)
+{
+   s->binaryTrace = binaryTrace;
+}
+
+void setSchedulerSnapshots(scheduler* s, int count)
+{
+   s->snapshotCount = count;
+}
+
+int setSchedulerCheckpoint(scheduler* s, const char* fileName, int resume)
+{
+   size_t length = strlen(fileName);
+   s->checkpoint.fileName = strdup(fileName);
+   s->checkpoint.logName = malloc(length + sizeof(".finished"));
+   s->checkpoint.tempName = malloc(length + sizeof(".tmp"));
+   if ((NULL == s->checkpoint.fileName) || (NULL == s->checkpoint.logName) || (NULL == s->checkpoint.tempName))
+   {
+      fprintf(stderr, "Out of memory for the checkpoint\n");
+      return -1;
+   }
+
+   sprintf(s->checkpoint.logName, "%s.finished", fileName);
+   sprintf(s->checkpoint.tempName, "%s.tmp", fileName);
+   s->checkpoint.resume = resume;
+   return 0;
+}
+
+int loadScheduler(scheduler* s, const char* fileName)
+{
+   return parseInputFile(s, fileName);
+}
+
+int loadSchedulerData(scheduler* s, const char* data, size_t size)
+{
+   parseInput(s, data, size);
+   return 0;
+}
+
+int loadSchedulerStream(scheduler* s, int fd)
+{
+   s->streaming = TRUE;
+   parseStreamHeader(s, fd);
+   return s->failed ? -1 : 0;
+}
+
+int runScheduler(scheduler* s)
+{
+   if (s->output.fd < 0)
+   {
+      fprintf(stderr, "No output set for the scheduler\n");
+      return -1;
+   }
+
+   if ((s->sweepLast > 0) &&
+       ((RoundRobin != s->schedulerType) || s->streaming || (s->quantum < 1) ||
+        (s->sweepLast < s->quantum) || (s->sweepLast - s->quantum >= MAX_INT)))
+   {
+      fprintf(stderr, "A quantum sweep needs round robin, a file input and a range like 1..64\n");
+      return -1;
+   }
+   if ((s->sweepLast > 0) && s->binaryTrace)
+   {
+      fprintf(stderr, "A quantum sweep doesn't have a binary trace\n");
+      return -1;
+   }
+   if ((CompletelyFair == s->schedulerType) && (s->quantum < 1))
+   {
+      fprintf(stderr, "CFS needs a quantum of at least 1\n");
+      return -1;
+   }
+   if ((MultilevelFeedbackQueue == s->schedulerType) && (0 != setupLevels(s)))
+   {
+      fprintf(stderr, "A multilevel feedback queue needs 1 to %d levels and quanta of at least 1\n", MAX_LEVELS);
+      return -1;
+   }
+
+   if ((NULL != s->checkpoint.fileName) && (s->streaming || (s->sweepLast > 0)))
+   {
+      fprintf(stderr, "Only a single run of an input file can be checkpointed\n");
+      return -1;
+   }
+   if ((s->snapshotCount > 0) && (s->streaming || (s->sweepLast > 0)))
+   {
+      fprintf(stderr, "Only a single run of an input file can have snapshots\n");
+      return -1;
+   }
+   if ((s->snapshotCount > 0) && s->checkpoint.resume)
+   {
+      fprintf(stderr, "A resumed run has no snapshots of what came before, so it can't have any\n");
+      return -1;
+   }
+   if ((NULL != s->checkpoint.fileName) && (0 != openCheckpoint(s)))
+   {
+      return -1;
+   }
+
+   // Print relevant information about the set of processes to be scheduled.
+   // A binary trace keeps this text in its header, ahead of the names.
+   // A resumed run already has all of it in its output.
+   if (!s->checkpoint.resume)
+   {
+      if (s->binaryTrace)
+      {
+         writeTraceHeader(s);
+      }
+      printConfiguration(s);
+      if (s->binaryTrace)
+      {
+         writeTraceNames(s);
+      }
+   }
+
+   if (s->sweepLast > 0)
+   {
+      runSweep(s);
+      flushOutput(s);
+      return s->failed ? -1 : 0;
+   }
+
+   createRunState(s);
+   clock_gettime(CLOCK_MONOTONIC, &s->metrics.startTime);
+   if (s->summaryOnly)
+   {
+      s->silent = TRUE;
+   }
+   if (s->snapshotCount > 0)
+   {
+      s->snapshots.interval = (s->runtime / s->snapshotCount > 0) ? (s->runtime / s->snapshotCount) : 1;
+      s->snapshots.nextTime = 0;
+   }
+
+   runPolicy(s);
+   flushOutput(s);
+
+   // A run that got to the end has nothing left to resume.
+   if ((NULL != s->checkpoint.fileName) && !s->failed)
+   {
+      closeCheckpoint(s);
+      unlink(s->checkpoint.fileName);
+      unlink(s->checkpoint.logName);
+   }
+
+   return s->failed ? -1 : 0;
+}
+
+// Based on the scheduling type, use the appropriate scheduling algorithm.
+void runPolicy(scheduler* s)
+{
+   switch (s->schedulerType)
+   {
+      foreach_schedulerType(GENERATE_DISPATCH)
+      default:
+         break;
+   }
+}
+
+int getSchedulerSummary(scheduler* s, schedulerSummary* summary)
+{
+   *summary = s->summary;
+   return s->failed ? -1 : 0;
+}
+
+int findSchedulerProcess(scheduler* s, const char* name)
+{
+   int length = strlen(name);
+   int i;
+   for (i = 0; i < s->processCount; i++)
+   {
+      if ((s->processes.nameLength[i] == length) && (0 == memcmp(s->processes.name[i], name, length)))
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+int whatIfScheduler(scheduler* s, int idx, long long arrival, long long burst, int fd, schedulerSummary* summary)
+{
+   snapshotState* snapshots = &s->snapshots;
+   if ((0 == snapshots->count) || (NULL != s->cores))
+   {
+      fprintf(stderr, "A what-if run needs a finished run with snapshots\n");
+      return -1;
+   }
+   if ((idx < 0) || (idx >= s->processCount) || (0 == burst))
+   {
+      fprintf(stderr, "A what-if run needs a process of the input and a burst of at least 1\n");
+      return -1;
+   }
+
+   long long oldArrival = s->processes.arrival[idx];
+   long long oldBurst = s->processes.burst[idx];
+   arrival = (arrival < 0) ? oldArrival : arrival;
+   burst = (burst < 0) ? oldBurst : burst;
+
+   // Nothing changes before the process arrives, either way, so the run
+   // starts again from the last snapshot before then. The first snapshot
+   // is at time 0.
+   long long changedFrom = (arrival < oldArrival) ? arrival : oldArrival;
+   int low = 0;
+   int high = snapshots->count - 1;
+   while (low < high)
+   {
+      int mid = (low + high + 1) / 2;
+      if (snapshots->list[mid].time <= changedFrom)
+      {
+         low = mid;
+      }
+      else
+      {
+         high = mid - 1;
+      }
+   }
+   runSnapshot* snapshot = &snapshots->list[low];
+
+   // The what-if run shares the processes, and changes the one process
+   // until it is done.
+   scheduler run = *s;
+   run.silent = TRUE;
+   run.summaryOnly = FALSE;
+   run.metricsFile = NULL;
+   run.failed = FALSE;
+   run.snapshotCount = 0;
+   memset(&run.output, 0, sizeof(outputWriter));
+   run.output.fd = -1;
+   memset(&run.state, 0, sizeof(runState));
+   memset(&run.summary, 0, sizeof(schedulerSummary));
+   memset(&run.metrics, 0, sizeof(runMetrics));
+   memset(&run.checkpoint, 0, sizeof(checkpointState));
+   run.checkpoint.logFd = -1;
+   memset(&run.snapshots, 0, sizeof(snapshotState));
+   run.snapshots.from = snapshot;
+   run.snapshots.log = snapshots->log;
+   run.snapshots.log.length = snapshot->logLength;
+   run.snapshots.log.position = 0;
+
+   moveProcess(s, idx, arrival, burst);
+   createRunState(&run);
+   runPolicy(&run);
+   moveProcess(s, idx, oldArrival, oldBurst);
+
+   if (NULL != summary)
+   {
+      *summary = run.summary;
+   }
+
+   // The stats of both runs, then of each process that finished at another
+   // time, and of the process that changed.
+   BOOL failed = run.failed;
+   int reportFd = dup(fd);
+   FILE* f = (reportFd >= 0) ? fdopen(reportFd, "w") : NULL;
+   if (NULL == f)
+   {
+      fprintf(stderr, "Can't write the what-if report\n");
+      destroyRunState(&run);
+      return -1;
+   }
+
+   process p = loadProcess(&s->processes, idx);
+   fputs("What if ", f);
+   fwrite(p.name, 1, p.nameLength, f);
+   fprintf(f, " arrived at %lld with burst %lld, run again from time %lld\n", arrival, burst, snapshot->time);
+   printWhatIfSummary(f, "Before", &s->summary);
+   printWhatIfSummary(f, "After", &run.summary);
+
+   int i;
+   for (i = 0; i < s->processCount; i++)
+   {
+      if ((s->state.endTime[i] != run.state.endTime[i]) || (i == idx))
+      {
+         p = loadProcess(&s->processes, i);
+         fwrite(p.name, 1, p.nameLength, f);
+         printOutcome(f, &p, s->state.endTime[i]);
+         fputs(" ->", f);
+         if (i == idx)
+         {
+            p.arrival = arrival;
+            p.burst = burst;
+         }
+         printOutcome(f, &p, run.state.endTime[i]);
+         fputc('\n', f);
+      }
+   }
+   fputc('\n', f);
+
+   if (0 != fclose(f))
+   {
+      fprintf(stderr, "Can't write the what-if report\n");
+      failed = TRUE;
+   }
+   destroyRunState(&run);
+
+   return failed ? -1 : 0;
+}
+
+// Parse the input file.
+// After this function is called, the scheduler has values that reflect
+// the content of the input.
+// The file is memory-mapped and tokenized in place, so lines can be of any
+// length and nothing is copied out of it.
+int parseInputFile(scheduler* s, const char* fileName)
+{
+   int fd = open(fileName, O_RDONLY);
+   if (fd < 0)
+   {
+      fprintf(stderr, "Can't open input file %s\n", fileName);
+      return -1;
+   }
+
+   struct stat info;
+   if (fstat(fd, &info) < 0)
+   {
+      fprintf(stderr, "Can't read input file %s\n", fileName);
+      close(fd);
+      return -1;
+   }
+
+   s->inputData = NULL;
+   s->inputSize = info.st_size;
+   if (s->inputSize > 0)
+   {
+      s->inputData = mmap(NULL, s->inputSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (MAP_FAILED == s->inputData)
+      {
+         fprintf(stderr, "Can't map input file %s\n", fileName);
+         s->inputData = NULL;
+         close(fd);
+         return -1;
+      }
+      madvise(s->inputData, s->inputSize, MADV_SEQUENTIAL);
+   }
+   close(fd);
+
+   parseInput(s, s->inputData, s->inputSize);
+
+   return 0;
+}
+
+// Parse input that is already in memory, without copying it.
+void parseInput(scheduler* s, const char* data, size_t size)
+{
+   const char* cursor = data;
+   const char* end = data + size;
+   int processesIndex = 0;
+
+   // Read each line of the input.
+   while (cursor < end)
+   {
+      const char* lineEnd = memchr(cursor, '\n', end - cursor);
+      if (NULL == lineEnd)
+      {
+         lineEnd = end;
+      }
+
+      process p = { 0 };
+      if (parseLine(s, cursor, lineEnd, &p))
+      {
+         if (processesIndex >= s->processCount)
+         {
+            fprintf(stderr, "More processes than processcount %d\n", s->processCount);
+            free(p.cycles);
+         }
+         else
+         {
+            p.order = processesIndex;
+            storeProcess(&s->processes, processesIndex++, &p);
+         }
+      }
+      cursor = lineEnd + 1;
+   }
+
+   buildArrivalOrder(s);
+}
+
+void releaseInputFile(scheduler* s)
+{
+   if (NULL != s->inputData)
+   {
+      munmap(s->inputData, s->inputSize);
+      s->inputData = NULL;
+   }
+}
+
+// Iterate through the tokens of a single line.
+// Returns TRUE if the line describes a process, which is then parsed into p.
+BOOL parseLine(scheduler* s, const char* cursor, const char* lineEnd, process* p)
+{
+   token t;
+   while (nextToken(&cursor, lineEnd, &t))
+   {
+      switch (lookupKeyword(&t))
+      {
+         // If '#', the rest of the line is a comment.
+         case KeywordComment:
+         case KeywordEnd:
+            return FALSE;
+
+         // Streaming mode does not need the count up front.
+         case KeywordProcessCount:
+            s->processCount = parseNumber(&cursor, lineEnd);
+            if (!s->streaming)
+            {
+               resizeProcessTable(&s->processes, 0, s->processCount);
+            }
+            break;
+
+         case KeywordRunFor:
+            s->runtime = parseNumber(&cursor, lineEnd);
+            break;
+
+         case KeywordUse:
+         {
+            int type = -1;
+            if (nextToken(&cursor, lineEnd, &t))
+            {
+               int i;
+               for (i = 0; i < (int) (sizeof(schedulerTypeKeyword) / sizeof(schedulerTypeKeyword[0])); i++)
+               {
+                  if ((t.length == (int) strlen(schedulerTypeKeyword[i])) &&
+                      (0 == memcmp(t.start, schedulerTypeKeyword[i], t.length)))
+                  {
+                     type = i;
+                  }
+               }
+            }
+
+            if (-1 != type)
+            {
+               s->schedulerType = type;
+            }
+            // Handle error
+            else
+            {
+               fprintf(stderr, "Invalid scheduling type\n");
+            }
+            break;
+         }
+
+         // A range like 1..64 asks for a sweep over each quantum.
+         case KeywordQuantum:
+            if (nextToken(&cursor, lineEnd, &t))
+            {
+               parseQuantum(s, &t);
+            }
+            break;
+
+         case KeywordCpus:
+            s->cpuCount = parseNumber(&cursor, lineEnd);
+            break;
+
+         case KeywordLevels:
+            s->levelCount = parseNumber(&cursor, lineEnd);
+            break;
+
+         // The quantum of each level from the top, like "quanta 2 4 8".
+         case KeywordQuanta:
+            parseQuanta(s, &cursor, lineEnd);
+            break;
+
+         case KeywordBoost:
+            s->boostPeriod = parseNumber(&cursor, lineEnd);
+            break;
+
+         // The rest of the line describes the process.
+         case KeywordProcess:
+            parseProcess(cursor, lineEnd, p);
+            return TRUE;
+
+         // Handle error.
+         default:
+            fprintf(stderr, "Invalid token\n");
+            return FALSE;
+      }
+   }
+
+   return FALSE;
+}
+
+// After the first burst, "io N burst M" pairs give the I/O waits of the
+// process and the bursts that follow them. An I/O wait without a burst
+// after it is ignored.
+void parseProcess(const char* cursor, const char* lineEnd, process* p)
+{
+   token t;
+   long long io = -1;
+   while (nextToken(&cursor, lineEnd, &t))
+   {
+      switch (lookupKeyword(&t))
+      {
+         case KeywordName:
+            if (nextToken(&cursor, lineEnd, &t))
+            {
+               p->name = t.start;
+               p->nameLength = t.length;
+            }
+            break;
+
+         case KeywordArrival:
+            p->arrival = parseNumber(&cursor, lineEnd);
+            break;
+
+         case KeywordBurst:
+            if (io < 0)
+            {
+               p->burst = parseNumber(&cursor, lineEnd);
+               break;
+            }
+            p->cycles = realloc(p->cycles, 2 * (p->cycleCount + 1) * sizeof(long long));
+            p->cycles[2 * p->cycleCount] = io;
+            p->cycles[2 * p->cycleCount + 1] = parseNumber(&cursor, lineEnd);
+            p->cycleCount++;
+            io = -1;
+            break;
+
+         case KeywordIo:
+            io = parseNumber(&cursor, lineEnd);
+            if (io < 0)
+            {
+               io = 0;
+            }
+            break;
+
+         case KeywordWeight:
+            p->weight = parseNumber(&cursor, lineEnd);
+            break;
+
+         // Handle error
+         default:
+            fprintf(stderr, "Invalid scheduling type\n");
+            break;
+      }
+   }
+}
+
+// Find the next whitespace-delimited token on the line.
+BOOL nextToken(const char** cursor, const char* lineEnd, token* t)
+{
+   const char* c = *cursor;
+
+   while ((c < lineEnd) && ((' ' == *c) || ('\t' == *c) || ('\r' == *c)))
+   {
+      c++;
+   }
+
+   t->start = c;
+
+   while ((c < lineEnd) && (' ' != *c) && ('\t' != *c) && ('\r' != *c))
+   {
+      c++;
+   }
+
+   t->length = c - t->start;
+   *cursor = c;
+
+   return (t->length > 0);
+}
+
+// Read the next token as a number.
+long long parseNumber(const char** cursor, const char* lineEnd)
+{
+   token t;
+   if (!nextToken(cursor, lineEnd, &t))
+   {
+      return 0;
+   }
+
+   return tokenToNumber(t.start, t.start + t.length);
+}
+
+// Read either a single quantum or a range of quanta to sweep.
+void parseQuantum(scheduler* s, token* t)
+{
+   const char* end = t->start + t->length;
+   const char* range = t->start;
+
+   while ((range + 1 < end) && !(('.' == range[0]) && ('.' == range[1])))
+   {
+      range++;
+   }
+
+   s->quantum = tokenToNumber(t->start, end);
+   s->sweepLast = (range + 1 < end) ? tokenToNumber(range + 2, end) : 0;
+}
+
+// Read the quanta of the levels up to the end of the line or a comment,
+// which is left for the caller.
+void parseQuanta(scheduler* s, const char** cursor, const char* lineEnd)
+{
+   token t;
+   const char* next = *cursor;
+   s->levelQuantaCount = 0;
+
+   while (nextToken(&next, lineEnd, &t) && ('#' != t.start[0]))
+   {
+      if (s->levelQuantaCount < MAX_LEVELS)
+      {
+         s->levelQuanta[s->levelQuantaCount++] = tokenToNumber(t.start, t.start + t.length);
+      }
+      *cursor = next;
+   }
+}
+
+// Fill in the levels a multilevel feedback queue wasn't given. Each level
+// without a quantum of its own gets twice the quantum of the level above,
+// starting from the round robin quantum.
+int setupLevels(scheduler* s)
+{
+   if (0 == s->levelCount)
+   {
+      s->levelCount = (s->levelQuantaCount > 0) ? s->levelQuantaCount : DEFAULT_LEVELS;
+   }
+   if ((s->levelCount < 1) || (s->levelCount > MAX_LEVELS))
+   {
+      return -1;
+   }
+
+   int l;
+   for (l = 0; l < s->levelCount; l++)
+   {
+      if (l >= s->levelQuantaCount)
+      {
+         s->levelQuanta[l] = (l > 0) ? (2 * s->levelQuanta[l - 1]) : ((s->quantum > 0) ? s->quantum : 1);
+      }
+      if (s->levelQuanta[l] < 1)
+      {
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+// Convert text to a 64-bit number, with the same leniency as atoi().
+long long tokenToNumber(const char* c, const char* end)
+{
+   BOOL negative = FALSE;
+   long long val = 0;
+
+   if ((c < end) && (('-' == *c) || ('+' == *c)))
+   {
+      negative = ('-' == *c);
+      c++;
+   }
+
+   while ((c < end) && (*c >= '0') && (*c <= '9'))
+   {
+      val = val * 10 + (*c - '0');
+      c++;
+   }
+
+   return negative ? -val : val;
+}
+
+// Map a token to a keyword. The length and first character are enough to
+// tell the keywords apart, so only one full comparison is ever needed.
+keywordEnum lookupKeyword(token* t)
+{
+   const char* keyword = NULL;
+   keywordEnum result = KeywordUnknown;
+
+   switch (t->length)
+   {
+      case 1:  keyword = "#";            result = KeywordComment;      break;
+      case 2:  keyword = "io";           result = KeywordIo;           break;
+      case 3:
+         if ('e' == t->start[0])       { keyword = "end";          result = KeywordEnd; }
+         else                          { keyword = "use";          result = KeywordUse; }
+         break;
+      case 4:
+         if ('n' == t->start[0])       { keyword = "name";         result = KeywordName; }
+         else                          { keyword = "cpus";         result = KeywordCpus; }
+         break;
+      case 5:
+         if ('u' == t->start[1])       { keyword = "burst";        result = KeywordBurst; }
+         else                          { keyword = "boost";        result = KeywordBoost; }
+         break;
+      case 6:
+         if ('r' == t->start[0])       { keyword = "runfor";       result = KeywordRunFor; }
+         else if ('l' == t->start[0])  { keyword = "levels";       result = KeywordLevels; }
+         else if ('w' == t->start[0])  { keyword = "weight";       result = KeywordWeight; }
+         else                          { keyword = "quanta";       result = KeywordQuanta; }
+         break;
+      case 7:
+         if ('a' == t->start[0])       { keyword = "arrival";      result = KeywordArrival; }
+         else if ('q' == t->start[0])  { keyword = "quantum";      result = KeywordQuantum; }
+         else                          { keyword = "process";      result = KeywordProcess; }
+         break;
+      case 12: keyword = "processcount"; result = KeywordProcessCount; break;
+      default:
+         break;
+   }
+
+   if ((NULL == keyword) || (0 != memcmp(t->start, keyword, t->length)))
+   {
+      return KeywordUnknown;
+   }
+
+   return result;
+}
+
+// Order two sort entries by key, then by process index.
+int compareSortEntries(const void* a, const void* b)
+{
+   const sortEntry* entryA = a;
+   const sortEntry* entryB = b;
+
+   if (entryA->key != entryB->key)
+   {
+      return (entryA->key < entryB->key) ? -1 : 1;
+   }
+
+   return entryA->idx - entryB->idx;
+}
+
+// Sort process indices by the given keys. The keys are copied next to the
+// indices so that the comparison doesn't need the scheduler.
+void sortProcesses(int* indices, const long long* keys, int count)
+{
+   sortEntry* entries = calloc(count, sizeof(sortEntry));
+
+   int i;
+   for (i = 0; i < count; i++)
+   {
+      entries[i].key = keys[i];
+      entries[i].idx = indices[i];
+   }
+
+   qsort(entries, count, sizeof(sortEntry), compareSortEntries);
+
+   for (i = 0; i < count; i++)
+   {
+      indices[i] = entries[i].idx;
+   }
+
+   free(entries);
+}
+
+// Build the arrival-ordered index that the schedulers walk with a cursor,
+// so each arrival is found once instead of checking every process each event.
+// Input order breaks ties between processes that arrive at the same time.
+void buildArrivalOrder(scheduler* s)
+{
+   s->arrivalOrder = calloc(s->processCount, sizeof(int));
+   s->arrivalTimes = calloc(s->processCount, sizeof(long long));
+
+   int i;
+   for (i = 0; i < s->processCount; i++)
+   {
+      s->arrivalOrder[i] = i;
+   }
+
+   sortProcesses(s->arrivalOrder, s->processes.arrival, s->processCount);
+
+   for (i = 0; i < s->processCount; i++)
+   {
+      s->arrivalTimes[i] = s->processes.arrival[s->arrivalOrder[i]];
+   }
+}
+
+// Print basic information about the data that is about to be processed.
+// A stream does not have to say how many processes it holds.
+void printConfiguration(scheduler* s)
+{
+   if (!s->streaming || (s->processCount > 0))
+   {
+      writeInt(s, s->processCount);
+      writeString(s, " processes\n");
+   }
+   if (s->cpuCount > 1)
+   {
+      writeInt(s, s->cpuCount);
+      writeString(s, " CPUs\n");
+   }
+   writeString(s, "Using ");
+   writeString(s, schedulerTypeString[s->schedulerType]);
+   writeString(s, "\n");
+   if ((RoundRobin == s->schedulerType) || (CompletelyFair == s->schedulerType))
+   {
+      writeString(s, "Quantum ");
+      writeInt(s, s->quantum);
+      if (s->sweepLast > 0)
+      {
+         writeString(s, "..");
+         writeInt(s, s->sweepLast);
+      }
+      writeString(s, "\n\n");
+   }
+   else if (MultilevelFeedbackQueue == s->schedulerType)
+   {
+      writeString(s, "Quanta");
+      int l;
+      for (l = 0; l < s->levelCount; l++)
+      {
+         writeString(s, " ");
+         writeInt(s, s->levelQuanta[l]);
+      }
+      writeString(s, "\n");
+      if (s->boostPeriod > 0)
+      {
+         writeString(s, "Boost ");
+         writeInt(s, s->boostPeriod);
+         writeString(s, "\n");
+      }
+      writeString(s, "\n");
+   }
+   else
+   {
+      writeString(s, "\n");
+   }
+}
+
+/** Buffered output **/
+// A run that is resumed picks its output up where its checkpoint left it,
+// so the file is only cut short once the checkpoint is read.
+int openOutput(scheduler* s, const char* fileName)
+{
+   int fd = open(fileName, O_WRONLY | O_CREAT | (s->checkpoint.resume ? 0 : O_TRUNC), 0644);
+   if (fd < 0)
+   {
+     fprintf(stderr, "Can't open output file %s\n", fileName);
+     return -1;
+   }
+
+   attachOutput(s, fd, TRUE);
+   return 0;
+}
+
+// The output file descriptor is only closed if the scheduler opened it.
+void attachOutput(scheduler* s, int fd, BOOL ownsFd)
+{
+   closeOutput(s);
+   s->output.fd = fd;
+   s->output.ownsFd = ownsFd;
+   s->output.buffer = malloc(OUTPUT_BUFFER_SIZE);
+   s->output.length = 0;
+}
+
+void closeOutput(scheduler* s)
+{
+   if (s->output.fd < 0)
+   {
+      return;
+   }
+
+   flushOutput(s);
+   if (s->output.ownsFd)
+   {
+      close(s->output.fd);
+   }
+   free(s->output.buffer);
+   s->output.buffer = NULL;
+   s->output.fd = -1;
+}
+
+// Write a block of data to the output file, retrying partial writes.
+// After a failed write the rest of the trace is dropped.
+void writeAll(scheduler* s, const char* data, int size)
+{
+   while ((size > 0) && !s->failed)
+   {
+      ssize_t written = write(s->output.fd, data, size);
+      if (written < 0)
+      {
+         if (EINTR == errno)
+         {
+            continue;
+         }
+         fprintf(stderr, "Can't write output file: %s\n", strerror(errno));
+         s->failed = TRUE;
+         return;
+      }
+      data += written;
+      size -= written;
+   }
+}
+
+// Hand everything buffered so far to the kernel.
+void flushOutput(scheduler* s)
+{
+   writeAll(s, s->output.buffer, s->output.length);
+   s->output.length = 0;
+}
+
+void writeBytes(scheduler* s, const char* data, int size)
+{
+   if (s->output.length + size > OUTPUT_BUFFER_SIZE)
+   {
+      flushOutput(s);
+
+      // Anything that can't fit in the buffer goes straight out.
+      if (size > OUTPUT_BUFFER_SIZE)
+      {
+         writeAll(s, data, size);
+         return;
+      }
+   }
+
+   memcpy(s->output.buffer + s->output.length, data, size);
+   s->output.length += size;
+}
+
+void writeString(scheduler* s, const char* str)
+{
+   writeBytes(s, str, strlen(str));
+}
+
+// Format an integer in decimal without going through printf.
+void writeInt(scheduler* s, long long val)
+{
+   char digits[24];
+   char* start = digits + sizeof(digits);
+   unsigned long long magnitude = (val < 0) ? -(unsigned long long) val : (unsigned long long) val;
+
+   do
+   {
+      *--start = '0' + (magnitude % 10);
+      magnitude /= 10;
+   } while (magnitude > 0);
+
+   if (val < 0)
+   {
+      *--start = '-';
+   }
+
+   writeBytes(s, start, digits + sizeof(digits) - start);
+}
+
+/** Binary trace **/
+void writeByte(scheduler* s, int val)
+{
+   char byte = val;
+   writeBytes(s, &byte, 1);
+}
+
+// Seven bits per byte, lowest first, with the high bit set on all but the
+// last byte.
+void writeVarint(scheduler* s, unsigned long long val)
+{
+   char bytes[10];
+   int length = 0;
+
+   while (val >= 0x80)
+   {
+      bytes[length++] = (char) (val | 0x80);
+      val >>= 7;
+   }
+   bytes[length++] = (char) val;
+
+   writeBytes(s, bytes, length);
+}
+
+// Zigzag encoding keeps small negative numbers short.
+void writeSignedVarint(scheduler* s, long long val)
+{
+   writeVarint(s, ((unsigned long long) val << 1) ^ (unsigned long long) (val >> 63));
+}
+
+void writeTraceRecord(scheduler* s, traceRecordType type, long long time)
+{
+   writeByte(s, type);
+   writeVarint(s, time - s->traceTime);
+   s->traceTime = time;
+}
+
+void writeTraceCpu(scheduler* s, cpuCore* core)
+{
+   if (s->cpuCount > 1)
+   {
+      writeVarint(s, core->id);
+   }
+}
+
+void writeTraceHeader(scheduler* s)
+{
+   writeBytes(s, TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+   writeByte(s, TRACE_VERSION);
+   writeVarint(s, (s->cpuCount > 1) ? s->cpuCount : 1);
+}
+
+// End the configuration text and write the name table. A stream names its
+// processes as they arrive instead.
+void writeTraceNames(scheduler* s)
+{
+   writeByte(s, 0);
+
+   int count = s->streaming ? 0 : s->processCount;
+   writeVarint(s, count);
+
+   int i;
+   for (i = 0; i < count; i++)
+   {
+      writeVarint(s, s->processes.nameLength[i]);
+      writeBytes(s, s->processes.name[i], s->processes.nameLength[i]);
+   }
+}
+
+void writeTraceName(scheduler* s, int order, const char* name, int nameLength)
+{
+   writeByte(s, TraceName);
+   writeVarint(s, order);
+   writeVarint(s, nameLength);
+   writeBytes(s, name, nameLength);
+}
+
+// A stretch of idle ticks is a single record, since the same cores are
+// idle on every tick of it.
+void writeTraceIdle(scheduler* s, long long time, long long ticks)
+{
+   writeTraceRecord(s, TraceIdle, time);
+   writeVarint(s, ticks);
+
+   if (s->cpuCount > 1)
+   {
+      int idleCount = 0;
+      int i;
+      for (i = 0; i < s->cpuCount; i++)
+      {
+         idleCount += (-1 == s->cores[i].idxOfCurrent);
+      }
+
+      writeVarint(s, idleCount);
+      for (i = 0; i < s->cpuCount; i++)
+      {
+         if (-1 == s->cores[i].idxOfCurrent)
+         {
+            writeVarint(s, i);
+         }
+      }
+   }
+}
+
+/** Standard prints used in each algorithm **/
+// Each trace line starts with "Time <time>: ".
+void writeTimePrefix(scheduler* s, long long time)
+{
+   writeBytes(s, "Time ", 5);
+   writeInt(s, time);
+   writeBytes(s, ": ", 2);
+}
+
+void printProcessArrived(scheduler* s, long long time, int idx)
+{
+   if (s->silent)
+   {
+      return;
+   }
+
+   if (s->binaryTrace)
+   {
+      // A process of a stream is named when it arrives.
+      if (s->streaming)
+      {
+         writeTraceName(s, s->processes.order[idx], s->processes.name[idx], s->processes.nameLength[idx]);
+      }
+      writeTraceRecord(s, TraceArrived, time);
+      writeVarint(s, s->processes.order[idx]);
+      return;
+   }
+
+   writeTimePrefix(s, time);
+   writeBytes(s, s->processes.name[idx], s->processes.nameLength[idx]);
+   writeBytes(s, " arrived\n", 9);
+}
+
+// With more than one CPU, trace lines say which core they happened on.
+void writeCpuSuffix(scheduler* s, cpuCore* core)
+{
+   if (s->cpuCount > 1)
+   {
+      writeBytes(s, " on CPU ", 8);
+      writeInt(s, core->id);
+   }
+   writeBytes(s, "\n", 1);
+}
+
+// A core switches context whenever it runs a different process than the
+// last one it ran.
+void setProcessSelected(scheduler* s, long long time, cpuCore* core)
+{
+   int idx = core->idxOfCurrent;
+
+   if (core->lastOrder != s->processes.order[idx])
+   {
+      core->lastOrder = s->processes.order[idx];
+      s->summary.contextSwitches++;
+   }
+
+   if (s->silent)
+   {
+      return;
+   }
+
+   if (s->binaryTrace)
+   {
+      writeTraceRecord(s, TraceSelected, time);
+      writeVarint(s, s->processes.order[idx]);
+      writeSignedVarint(s, s->state.remaining[idx]);
+      writeTraceCpu(s, core);
+      return;
+   }
+
+   writeTimePrefix(s, time);
+   writeBytes(s, s->processes.name[idx], s->processes.nameLength[idx]);
+   writeBytes(s, " selected (burst ", 17);
+   writeInt(s, s->state.remaining[idx]);
+   writeBytes(s, ")", 1);
+   writeCpuSuffix(s, core);
+}
+
+void printProcessStolen(scheduler* s, long long time, int idx, cpuCore* thief, cpuCore* victim)
+{
+   if (s->silent)
+   {
+      return;
+   }
+
+   if (s->binaryTrace)
+   {
+      writeTraceRecord(s, TraceStolen, time);
+      writeVarint(s, s->processes.order[idx]);
+      writeVarint(s, thief->id);
+      writeVarint(s, victim->id);
+      return;
+   }
+
+   writeTimePrefix(s, time);
+   writeString(s, "CPU ");
+   writeInt(s, thief->id);
+   writeString(s, " stole ");
+   writeBytes(s, s->processes.name[idx], s->processes.nameLength[idx]);
+   writeString(s, " from CPU ");
+   writeInt(s, victim->id);
+   writeBytes(s, "\n", 1);
+}
+
+// In streaming mode the stats of a process are printed as soon as it
+// finishes, so that the process can be freed.
+void setProcessFinished(scheduler* s, long long time, int idx, cpuCore* core)
+{
+   process p = loadProcess(&s->processes, idx);
+   long long turnaround = time - p.arrival;
+   long long cpuTime = p.burst;
+   long long ioTime = 0;
+   addCycleTimes(&p, &cpuTime, &ioTime);
+
+   s->state.endTime[idx] = time;
+   s->summary.finishedCount++;
+   s->summary.totalWait += turnaround - cpuTime - ioTime;
+   s->summary.totalIoWait += ioTime;
+   s->summary.totalTurnaround += turnaround;
+   if (NULL != s->metricsFile)
+   {
+      recordProcessFinished(s, turnaround - cpuTime - ioTime, turnaround);
+   }
+   if (s->checkpoint.logFd >= 0)
+   {
+      noteProcessFinished(&s->checkpoint.finished, idx, time);
+   }
+   if (s->snapshots.interval > 0)
+   {
+      noteProcessFinished(&s->snapshots.log, idx, time);
+   }
+
+   if (!s->silent && s->binaryTrace)
+   {
+      writeTraceRecord(s, TraceFinished, time);
+      writeVarint(s, s->processes.order[idx]);
+      writeTraceCpu(s, core);
+   }
+   else if (!s->silent)
+   {
+      writeTimePrefix(s, time);
+      writeBytes(s, s->processes.name[idx], s->processes.nameLength[idx]);
+      writeBytes(s, " finished", 9);
+      writeCpuSuffix(s, core);
+   }
+
+   if (s->streaming)
+   {
+      printProcessStats(s, &p, time);
+      releaseProcess(s, idx);
+   }
+}
+
+// A process that has run its burst and has I/O left is blocked until the
+// I/O is done, and then runs its next burst.
+void setProcessStartedIo(scheduler* s, long long time, int idx, cpuCore* core)
+{
+   int cycle = s->state.cycle[idx]++;
+   long long io = s->processes.cycles[idx][2 * cycle];
+   s->state.remaining[idx] = s->processes.cycles[idx][2 * cycle + 1];
+   scheduleIo(s, idx, time + io);
+
+   if (s->silent)
+   {
+      return;
+   }
+
+   if (s->binaryTrace)
+   {
+      writeTraceRecord(s, TraceStartedIo, time);
+      writeVarint(s, s->processes.order[idx]);
+      writeVarint(s, io);
+      writeTraceCpu(s, core);
+      return;
+   }
+
+   writeTimePrefix(s, time);
+   writeBytes(s, s->processes.name[idx], s->processes.nameLength[idx]);
+   writeBytes(s, " started I/O (io ", 17);
+   writeInt(s, io);
+   writeBytes(s, ")", 1);
+   writeCpuSuffix(s, core);
+}
+
+// Set the timer of a blocked process to when its I/O is done.
+void scheduleIo(scheduler* s, int idx, long long when)
+{
+   if ((IO_TIMER(s, idx) >= s->timers.capacity) && !growWheel(&s->timers, IO_TIMER(s, idx) + 1))
+   {
+      fprintf(stderr, "Out of memory for the I/O of the processes\n");
+      s->failed = TRUE;
+      return;
+   }
+
+   wheelSchedule(&s->timers, IO_TIMER(s, idx), when);
+}
+
+void printProcessFinishedIo(scheduler* s, long long time, int idx)
+{
+   if (s->silent)
+   {
+      return;
+   }
+
+   if (s->binaryTrace)
+   {
+      writeTraceRecord(s, TraceFinishedIo, time);
+      writeVarint(s, s->processes.order[idx]);
+      return;
+   }
+
+   writeTimePrefix(s, time);
+   writeBytes(s, s->processes.name[idx], s->processes.nameLength[idx]);
+   writeBytes(s, " finished I/O\n", 14);
+}
+
+void printIdle(scheduler* s, long long time, cpuCore* core)
+{
+   writeTimePrefix(s, time);
+   writeBytes(s, "IDLE", 4);
+   writeCpuSuffix(s, core);
+}
+
+void printSchedulerFinished(scheduler* s, long long time)
+{
+   if (s->binaryTrace)
+   {
+      writeTraceRecord(s, TraceSchedulerFinished, time);
+      return;
+   }
+
+   writeString(s, "Finished at time ");
+   writeInt(s, time);
+   writeString(s, "\n\n");
+}
+
+// Add up the CPU bursts and I/O waits of the I/O cycles of a process.
+void addCycleTimes(process* p, long long* cpuTime, long long* ioTime)
+{
+   int i;
+   for (i = 0; i < p->cycleCount; i++)
+   {
+      *ioTime += p->cycles[2 * i];
+      *cpuTime += p->cycles[2 * i + 1];
+   }
+}
+
+// Print the wait and turnaround of a process, given when it finished. The
+// wait only counts time spent ready, so a process with I/O cycles also
+// prints the time it spent in I/O.
+void printProcessStats(scheduler* s, process* p, long long endTime)
+{
+   if (s->silent)
+   {
+      return;
+   }
+
+   long long cpuTime = p->burst;
+   long long ioTime = 0;
+   addCycleTimes(p, &cpuTime, &ioTime);
+
+   if (s->binaryTrace)
+   {
+      if (endTime <= 0)
+      {
+         writeByte(s, TraceUnfinished);
+         writeVarint(s, p->order);
+         return;
+      }
+
+      writeByte(s, (p->cycleCount > 0) ? TraceIoStats : TraceStats);
+      writeVarint(s, p->order);
+      writeSignedVarint(s, endTime - p->arrival - cpuTime - ioTime);
+      if (p->cycleCount > 0)
+      {
+         writeVarint(s, ioTime);
+      }
+      writeSignedVarint(s, endTime - p->arrival);
+      return;
+   }
+
+   writeBytes(s, p->name, p->nameLength);
+   if(endTime > 0)
+   {
+      writeBytes(s, " wait ", 6);
+      writeInt(s, endTime - p->arrival - cpuTime - ioTime);
+      if (p->cycleCount > 0)
+      {
+         writeBytes(s, " io ", 4);
+         writeInt(s, ioTime);
+      }
+      writeBytes(s, " turnaround ", 12);
+      writeInt(s, endTime - p->arrival);
+      writeBytes(s, "\n", 1);
+   }
+   else
+      writeBytes(s, " didn't finish\n", 15);
+}
+
+// Print the stats of every process once the simulation has ended.
+// A stream only has its unfinished processes left: first the ones that
+// arrived, then the ones the simulation never reached.
+void printFinalStats(scheduler* s)
+{
+   int i;
+   if (!s->streaming)
+   {
+      for (i = 0; i < s->processCount; i++)
+      {
+         process p = loadProcess(&s->processes, i);
+         printProcessStats(s, &p, s->state.endTime[i]);
+      }
+      return;
+   }
+
+   int* live = calloc(s->poolCapacity, sizeof(int));
+   long long* order = calloc(s->poolCapacity, sizeof(long long));
+   int liveCount = 0;
+   for (i = 0; i < s->poolCapacity; i++)
+   {
+      if (NULL != s->processes.name[i])
+      {
+         order[liveCount] = s->processes.order[i];
+         live[liveCount++] = i;
+      }
+   }
+
+   sortProcesses(live, order, liveCount);
+   free(order);
+   for (i = 0; i < liveCount; i++)
+   {
+      process p = loadProcess(&s->processes, live[i]);
+      printProcessStats(s, &p, 0);
+      releaseProcess(s, live[i]);
+   }
+   free(live);
+
+   while (peekStreamProcess(s))
+   {
+      if (s->binaryTrace && !s->silent)
+      {
+         writeTraceName(s, s->pendingProcess.order, s->pendingProcess.name, s->pendingProcess.nameLength);
+      }
+      printProcessStats(s, &s->pendingProcess, 0);
+      free((char*) s->pendingProcess.name);
+      free(s->pendingProcess.cycles);
+      s->hasPendingProcess = FALSE;
+   }
+}
+
+// In summary-only mode, the stats of all processes together stand in for
+// the stats of each.
+void printAggregateStats(scheduler* s)
+{
+   char line[128];
+   int finished = s->summary.finishedCount;
+
+   if (s->binaryTrace)
+   {
+      writeByte(s, (s->summary.totalIoWait > 0) ? TraceIoAggregate : TraceAggregate);
+      writeVarint(s, finished);
+      writeVarint(s, s->summary.processCount);
+      writeSignedVarint(s, s->summary.totalWait);
+      if (s->summary.totalIoWait > 0)
+      {
+         writeVarint(s, s->summary.totalIoWait);
+      }
+      writeSignedVarint(s, s->summary.totalTurnaround);
+      return;
+   }
+
+   writeInt(s, finished);
+   writeString(s, " of ");
+   writeInt(s, s->summary.processCount);
+   writeString(s, " processes finished");
+   if ((finished > 0) && (s->summary.totalIoWait > 0))
+   {
+      snprintf(line, sizeof(line), ", average wait %.2f, average io %.2f, average turnaround %.2f",
+               (double) s->summary.totalWait / finished, (double) s->summary.totalIoWait / finished,
+               (double) s->summary.totalTurnaround / finished);
+      writeString(s, line);
+   }
+   else if (finished > 0)
+   {
+      snprintf(line, sizeof(line), ", average wait %.2f, average turnaround %.2f",
+               (double) s->summary.totalWait / finished, (double) s->summary.totalTurnaround / finished);
+      writeString(s, line);
+   }
+   writeString(s, "\n");
+}
+
+// Print how much of the simulated time each core spent running processes.
+void printCpuStats(scheduler* s, long long time)
+{
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      long long busy = s->cores[i].busyTime;
+      long long utilization = (time > 0) ? (busy * 10000 / time) : 0;
+
+      if (s->binaryTrace)
+      {
+         writeByte(s, TraceCpuStats);
+         writeVarint(s, i);
+         writeVarint(s, busy);
+         continue;
+      }
+
+      writeString(s, "CPU ");
+      writeInt(s, i);
+      writeString(s, " busy ");
+      writeInt(s, busy);
+      writeString(s, " idle ");
+      writeInt(s, time - busy);
+      writeString(s, " utilization ");
+      writeInt(s, utilization / 100);
+      writeBytes(s, ".", 1);
+      writeBytes(s, &"0123456789"[(utilization % 100) / 10], 1);
+      writeBytes(s, &"0123456789"[utilization % 10], 1);
+      writeString(s, "%\n");
+   }
+}
+
+/** Streaming input **/
+// Parse the settings at the start of the stream, stopping at the first
+// process so that it is not read before the simulation needs it.
+void parseStreamHeader(scheduler* s, int fd)
+{
+   s->streamInput.fd = fd;
+   s->streamInput.capacity = STREAM_BUFFER_SIZE;
+   s->streamInput.buffer = malloc(s->streamInput.capacity);
+
+   peekStreamProcess(s);
+}
+
+// Read the next line of the stream. The line stays valid until the next call.
+// Anything written so far is flushed before waiting for more input, so the
+// trace keeps up with the stream.
+BOOL readStreamLine(scheduler* s, const char** lineStart, const char** lineEnd)
+{
+   streamReader* r = &s->streamInput;
+
+   while (TRUE)
+   {
+      char* newline = memchr(r->buffer + r->start, '\n', r->end - r->start);
+      if ((NULL != newline) || (r->atEnd && (r->start < r->end)))
+      {
+         *lineStart = r->buffer + r->start;
+         *lineEnd = (NULL != newline) ? newline : (r->buffer + r->end);
+         r->start = (NULL != newline) ? (newline + 1 - r->buffer) : r->end;
+         return TRUE;
+      }
+
+      if (r->atEnd)
+      {
+         return FALSE;
+      }
+
+      // Make room for more input, growing the buffer if one line fills it.
+      memmove(r->buffer, r->buffer + r->start, r->end - r->start);
+      r->end -= r->start;
+      r->start = 0;
+      if (r->end == r->capacity)
+      {
+         r->capacity *= 2;
+         r->buffer = realloc(r->buffer, r->capacity);
+      }
+
+      flushOutput(s);
+      ssize_t bytesRead = read(r->fd, r->buffer + r->end, r->capacity - r->end);
+      if (bytesRead < 0)
+      {
+         if (EINTR == errno)
+         {
+            continue;
+         }
+         fprintf(stderr, "Can't read input stream: %s\n", strerror(errno));
+         s->failed = TRUE;
+         r->atEnd = TRUE;
+         continue;
+      }
+
+      r->end += bytesRead;
+      r->atEnd = (0 == bytesRead);
+   }
+}
+
+// Make sure the next process of the stream has been read, if there is one.
+BOOL peekStreamProcess(scheduler* s)
+{
+   const char* lineStart;
+   const char* lineEnd;
+
+   while (!s->hasPendingProcess && readStreamLine(s, &lineStart, &lineEnd))
+   {
+      process p = { 0 };
+      if (parseLine(s, lineStart, lineEnd, &p))
+      {
+         // The line is about to be overwritten, so keep a copy of the name.
+         char* name = malloc(p.nameLength + 1);
+         memcpy(name, p.name, p.nameLength);
+         name[p.nameLength] = '\0';
+
+         s->pendingProcess = p;
+         s->pendingProcess.name = name;
+         s->pendingProcess.order = s->streamProcessesRead++;
+         s->hasPendingProcess = TRUE;
+      }
+   }
+
+   return s->hasPendingProcess;
+}
+
+// Streaming version of nextArrivingProcess(). The arriving process is moved
+// into a pool slot. Processes must be listed in order of arrival, since the
+// simulation can't go back to a time it has already passed.
+int nextStreamArrival(scheduler* s, long long time)
+{
+   while (peekStreamProcess(s) && (s->pendingProcess.arrival < time))
+   {
+      fprintf(stderr, "Process %s arrives at %lld after time %lld, skipping it\n",
+              s->pendingProcess.name, s->pendingProcess.arrival, time);
+      free((char*) s->pendingProcess.name);
+      free(s->pendingProcess.cycles);
+      s->hasPendingProcess = FALSE;
+   }
+
+   if (s->hasPendingProcess && (s->pendingProcess.arrival == time))
+   {
+      int idx = allocateProcess(s);
+      storeProcess(&s->processes, idx, &s->pendingProcess);
+      s->state.remaining[idx] = s->pendingProcess.burst;
+      s->state.endTime[idx] = 0;
+      if (NULL != s->state.level)
+      {
+         s->state.level[idx] = 0;
+      }
+      if (NULL != s->state.vruntime)
+      {
+         s->state.vruntime[idx] = 0;
+      }
+      s->state.cycle[idx] = 0;
+      s->hasPendingProcess = FALSE;
+      return idx;
+   }
+
+   return -1;
+}
+
+// Take a free slot from the process pool, doubling the pool if it is full.
+int allocateProcess(scheduler* s)
+{
+   if (0 == s->freeSlotCount)
+   {
+      int oldCapacity = s->poolCapacity;
+      s->poolCapacity = (oldCapacity > 0) ? (2 * oldCapacity) : 16;
+      resizeProcessTable(&s->processes, oldCapacity, s->poolCapacity);
+      s->freeSlots = realloc(s->freeSlots, s->poolCapacity * sizeof(int));
+      s->state.remaining = realloc(s->state.remaining, s->poolCapacity * sizeof(long long));
+      s->state.endTime = realloc(s->state.endTime, s->poolCapacity * sizeof(long long));
+      s->state.cycle = realloc(s->state.cycle, s->poolCapacity * sizeof(int));
+      if (MultilevelFeedbackQueue == s->schedulerType)
+      {
+         s->state.level = realloc(s->state.level, s->poolCapacity * sizeof(int));
+      }
+      if (CompletelyFair == s->schedulerType)
+      {
+         s->state.vruntime = realloc(s->state.vruntime, s->poolCapacity * sizeof(long long));
+         s->state.links = realloc(s->state.links, s->poolCapacity * sizeof(treeLink));
+      }
+
+      // Hand out the lowest slots first.
+      int i;
+      for (i = s->poolCapacity - 1; i >= oldCapacity; i--)
+      {
+         s->freeSlots[s->freeSlotCount++] = i;
+      }
+   }
+
+   return s->freeSlots[--s->freeSlotCount];
+}
+
+// Return a finished process to the pool. Slots in use always have a name.
+void releaseProcess(scheduler* s, int idx)
+{
+   free((char*) s->processes.name[idx]);
+   s->processes.name[idx] = NULL;
+   if (NULL != s->processes.cycles)
+   {
+      free(s->processes.cycles[idx]);
+      s->processes.cycles[idx] = NULL;
+      s->processes.cycleCount[idx] = 0;
+   }
+   s->freeSlots[s->freeSlotCount++] = idx;
+}
+
+/** Process table **/
+// Grow or shrink every array of the table. New slots are cleared.
+void resizeProcessTable(processTable* table, int oldCapacity, int capacity)
+{
+   table->arrival = realloc(table->arrival, capacity * sizeof(long long));
+   table->burst = realloc(table->burst, capacity * sizeof(long long));
+   table->order = realloc(table->order, capacity * sizeof(int));
+   table->weight = realloc(table->weight, capacity * sizeof(int));
+   table->name = realloc(table->name, capacity * sizeof(const char*));
+   table->nameLength = realloc(table->nameLength, capacity * sizeof(int));
+   if (NULL != table->cycles)
+   {
+      table->cycles = realloc(table->cycles, capacity * sizeof(long long*));
+      table->cycleCount = realloc(table->cycleCount, capacity * sizeof(int));
+   }
+   table->capacity = capacity;
+
+   if (capacity > oldCapacity)
+   {
+      int added = capacity - oldCapacity;
+      memset(&table->arrival[oldCapacity], 0, added * sizeof(long long));
+      memset(&table->burst[oldCapacity], 0, added * sizeof(long long));
+      memset(&table->order[oldCapacity], 0, added * sizeof(int));
+      memset(&table->weight[oldCapacity], 0, added * sizeof(int));
+      memset(&table->name[oldCapacity], 0, added * sizeof(const char*));
+      memset(&table->nameLength[oldCapacity], 0, added * sizeof(int));
+      if (NULL != table->cycles)
+      {
+         memset(&table->cycles[oldCapacity], 0, added * sizeof(long long*));
+         memset(&table->cycleCount[oldCapacity], 0, added * sizeof(int));
+      }
+   }
+}
+
+void destroyProcessTable(processTable* table)
+{
+   free(table->arrival);
+   free(table->burst);
+   free(table->order);
+   free(table->weight);
+   free(table->name);
+   free(table->nameLength);
+   if (NULL != table->cycles)
+   {
+      int i;
+      for (i = 0; i < table->capacity; i++)
+      {
+         free(table->cycles[i]);
+      }
+   }
+   free(table->cycles);
+   free(table->cycleCount);
+   memset(table, 0, sizeof(processTable));
+}
+
+void storeProcess(processTable* table, int idx, process* p)
+{
+   table->arrival[idx] = p->arrival;
+   table->burst[idx] = p->burst;
+   table->order[idx] = p->order;
+   table->weight[idx] = (p->weight > 0) ? p->weight : DEFAULT_WEIGHT;
+   table->name[idx] = p->name;
+   table->nameLength[idx] = p->nameLength;
+
+   // The table takes over the cycles of the process.
+   if ((NULL == table->cycles) && (p->cycleCount > 0))
+   {
+      table->cycles = calloc(table->capacity, sizeof(long long*));
+      table->cycleCount = calloc(table->capacity, sizeof(int));
+   }
+   if (NULL != table->cycles)
+   {
+      table->cycles[idx] = p->cycles;
+      table->cycleCount[idx] = p->cycleCount;
+   }
+   else
+   {
+      free(p->cycles);
+   }
+}
+
+// Gather the fields of one process, for the few places that need all of them.
+process loadProcess(processTable* table, int idx)
+{
+   process p;
+   p.name = table->name[idx];
+   p.nameLength = table->nameLength[idx];
+   p.order = table->order[idx];
+   p.weight = table->weight[idx];
+   p.arrival = table->arrival[idx];
+   p.burst = table->burst[idx];
+   p.cycles = (NULL != table->cycles) ? table->cycles[idx] : NULL;
+   p.cycleCount = (NULL != table->cycles) ? table->cycleCount[idx] : 0;
+   return p;
+}
+
+/** Run state **/
+// In streaming mode the run state grows with the process pool instead.
+void createRunState(scheduler* s)
+{
+   if (s->streaming)
+   {
+      return;
+   }
+
+   s->state.remaining = calloc(s->processCount, sizeof(long long));
+   s->state.endTime = calloc(s->processCount, sizeof(long long));
+   if (MultilevelFeedbackQueue == s->schedulerType)
+   {
+      s->state.level = calloc(s->processCount, sizeof(int));
+   }
+   if (CompletelyFair == s->schedulerType)
+   {
+      s->state.vruntime = calloc(s->processCount, sizeof(long long));
+      s->state.links = calloc(s->processCount, sizeof(treeLink));
+   }
+   if (NULL != s->processes.cycles)
+   {
+      s->state.cycle = calloc(s->processCount, sizeof(int));
+   }
+   if (s->processCount > 0)
+   {
+      memcpy(s->state.remaining, s->processes.burst, s->processCount * sizeof(long long));
+   }
+}
+
+void destroyRunState(scheduler* s)
+{
+   free(s->state.remaining);
+   free(s->state.endTime);
+   free(s->state.level);
+   free(s->state.vruntime);
+   free(s->state.links);
+   free(s->state.cycle);
+   s->state.remaining = NULL;
+   s->state.endTime = NULL;
+   s->state.level = NULL;
+   s->state.vruntime = NULL;
+   s->state.links = NULL;
+   s->state.cycle = NULL;
+}
+
+/** Event helpers shared by each algorithm **/
+// Return the index of the next process that arrives at the given time and
+// advance the cursor past it, or -1 once every such process has arrived.
+// Processes that arrive before the simulation reaches them are skipped.
+int nextArrivingProcess(scheduler* s, long long time, int* cursor)
+{
+   if (s->streaming)
+   {
+      return nextStreamArrival(s, time);
+   }
+
+   while ((*cursor < s->processCount) && (s->arrivalTimes[*cursor] < time))
+   {
+      (*cursor)++;
+   }
+
+   if ((*cursor < s->processCount) && (s->arrivalTimes[*cursor] == time))
+   {
+      return s->arrivalOrder[(*cursor)++];
+   }
+
+   return -1;
+}
+
+// Count the processes of the input that arrive at the given time, moving
+// the cursor up to the first of them. Streams arrive one at a time instead.
+int countArrivals(scheduler* s, long long time, int* cursor)
+{
+   while ((*cursor < s->processCount) && (s->arrivalTimes[*cursor] < time))
+   {
+      (*cursor)++;
+   }
+
+   int count = 0;
+   while ((*cursor + count < s->processCount) && (s->arrivalTimes[*cursor + count] == time))
+   {
+      count++;
+   }
+
+   return count;
+}
+
+// Find the earliest arrival still ahead of the cursor.
+// Returns the runtime if no other process arrives before the simulation ends.
+long long findNextArrival(scheduler* s, int cursor)
+{
+   if (s->streaming)
+   {
+      return (peekStreamProcess(s) && (s->pendingProcess.arrival < s->runtime)) ? s->pendingProcess.arrival : s->runtime;
+   }
+
+   if ((cursor < s->processCount) && (s->arrivalTimes[cursor] < s->runtime))
+   {
+      return s->arrivalTimes[cursor];
+   }
+
+   return s->runtime;
+}
+
+// With a single core, a process that is alone on it is picked again each
+// time its quantum runs out, until something arrives or wakes up, it
+// finishes or the run ends. Take it through all but the last of those
+// quanta in one step, writing the selections the scheduling loop would
+// have, and return the time of the last one, which is left to the loop.
+long long fastForwardLoneProcess(scheduler* s, long long time, int arrivalCursor)
+{
+   cpuCore* core = &s->cores[0];
+   int idx = core->idxOfCurrent;
+   if ((s->cpuCount > 1) || (-1 == idx) || (0 != core->quantumRemaining) || (s->quantum < 1) ||
+       (readyCount(core) > 0) || (s->state.remaining[idx] <= 0) || !isEmpty(&s->waking))
+   {
+      return time;
+   }
+
+   // Processes may still arrive now, after their timer went off. I/O ends
+   // come from the wheel, which is only looked at, since moving it to the
+   // next timer could take it past the time the process is left at.
+   long long limit = wheelPeek(&s->timers, findNextArrival(s, arrivalCursor));
+   if (time + s->state.remaining[idx] < limit)
+   {
+      limit = time + s->state.remaining[idx];
+   }
+
+   // The process is selected at time, time + quantum and so on before the limit.
+   long long count = (limit - time + s->quantum - 1) / s->quantum;
+   if (count < 2)
+   {
+      return time;
+   }
+
+   long long skipped = (count - 1) * s->quantum;
+   if (s->silent)
+   {
+      s->state.remaining[idx] -= skipped;
+   }
+   else
+   {
+      long long t;
+      for (t = time; t < time + skipped; t += s->quantum)
+      {
+         setProcessSelected(s, t, core);
+         s->state.remaining[idx] -= s->quantum;
+      }
+   }
+
+   core->busyTime += skipped;
+   s->summary.events += count - 1;
+   if (NULL != s->metricsFile)
+   {
+      recordQueueDepth(s, skipped);
+   }
+
+   return time + skipped;
+}
+
+// Set a timer to go off at the given time, which can't be before the last
+// event, or clear it if the simulation ends first.
+void setTimer(scheduler* s, int id, long long when)
+{
+   if (when < s->runtime)
+   {
+      wheelSchedule(&s->timers, id, when);
+   }
+   else
+   {
+      wheelCancel(&s->timers, id);
+   }
+}
+
+// Set the timer of a core to when its process finishes or runs out of
+// quantum, whichever comes first.
+void setCoreTimer(scheduler* s, cpuCore* core, long long time, BOOL timeSliced)
+{
+   long long runLimit = 0;
+   if (-1 != core->idxOfCurrent)
+   {
+      runLimit = s->state.remaining[core->idxOfCurrent];
+      if (timeSliced && (core->quantumRemaining > 0) &&
+          ((runLimit <= 0) || (core->quantumRemaining < runLimit)))
+      {
+         runLimit = core->quantumRemaining;
+      }
+   }
+
+   setTimer(s, core->id, (runLimit > 0) ? (time + runLimit) : s->runtime);
+}
+
+// Clear the timers due at the given time. What happens at an event mostly
+// follows from the state of the cores and the arrivals, so most timers only
+// tell when the next event is. Processes whose I/O is done wake up.
+void expireTimers(scheduler* s, long long time)
+{
+   int id;
+   while (-1 != (id = wheelPop(&s->timers, time)))
+   {
+      if ((id >= IO_TIMER(s, 0)) && !enqueue(&s->waking, id - IO_TIMER(s, 0)))
+      {
+         fprintf(stderr, "Out of memory for the I/O of the processes\n");
+         s->failed = TRUE;
+      }
+   }
+}
+
+// Jump from one event to the next, applying every tick in between at once.
+// The current process of each core runs for the whole stretch. Each tick
+// a core has nothing to run is logged as idle.
+void advanceTime(scheduler* s, long long time, long long nextEvent)
+{
+   long long elapsed = nextEvent - time;
+   BOOL anyIdle = FALSE;
+
+   s->summary.events++;
+   if (NULL != s->metricsFile)
+   {
+      recordQueueDepth(s, elapsed);
+   }
+
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      cpuCore* core = &s->cores[i];
+      if (-1 != core->idxOfCurrent)
+      {
+         s->state.remaining[core->idxOfCurrent] -= elapsed;
+         core->quantumRemaining -= elapsed;
+         core->busyTime += elapsed;
+      }
+      else
+      {
+         anyIdle = TRUE;
+      }
+   }
+
+   if (anyIdle && !s->silent && s->binaryTrace)
+   {
+      writeTraceIdle(s, time, elapsed);
+   }
+   else if (anyIdle && !s->silent)
+   {
+      long long t;
+      for (t = time; t < nextEvent; t++)
+      {
+         for (i = 0; i < s->cpuCount; i++)
+         {
+            if (-1 == s->cores[i].idxOfCurrent)
+            {
+               printIdle(s, t, &s->cores[i]);
+            }
+         }
+      }
+   }
+}
+
+/** CPU cores **/
+void createCores(scheduler* s)
+{
+   if (s->cpuCount < 1)
+   {
+      s->cpuCount = 1;
+   }
+
+   s->cores = calloc(s->cpuCount, sizeof(cpuCore));
+   createWheel(&s->timers, POLICY_TIMER(s) + 1);
+   createQueue(&s->waking, 0);
+
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      s->cores[i].id = i;
+      s->cores[i].idxOfCurrent = -1;
+      s->cores[i].lastOrder = -1;
+      s->cores[i].tree.root = -1;
+      s->cores[i].tree.leftmost = -1;
+      createQueue(&s->cores[i].readyQueue, 0);
+      createHeap(&s->cores[i].readyHeap, s->processCount / s->cpuCount);
+
+      // The level queues start empty and grow as processes reach them.
+      if (MultilevelFeedbackQueue == s->schedulerType)
+      {
+         s->cores[i].levelQueues = calloc(s->levelCount, sizeof(integerQueue));
+         int l;
+         for (l = 0; l < s->levelCount; l++)
+         {
+            createQueue(&s->cores[i].levelQueues[l], 0);
+         }
+      }
+   }
+}
+
+void destroyCores(scheduler* s)
+{
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      destroyQueue(&s->cores[i].readyQueue);
+      destroyHeap(&s->cores[i].readyHeap);
+      if (NULL != s->cores[i].levelQueues)
+      {
+         int l;
+         for (l = 0; l < s->levelCount; l++)
+         {
+            destroyQueue(&s->cores[i].levelQueues[l]);
+         }
+         free(s->cores[i].levelQueues);
+      }
+   }
+
+   free(s->cores);
+   s->cores = NULL;
+   destroyWheel(&s->timers);
+   destroyQueue(&s->waking);
+}
+
+// Number of processes waiting in the run queue of a core.
+int readyCount(cpuCore* core)
+{
+   return queueCount(&core->readyQueue) + core->readyHeap.size +
+          core->levelReady + core->tree.size;
+}
+
+// Determine if the current process of each core has finished.
+void finishProcesses(scheduler* s, long long time)
+{
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      cpuCore* core = &s->cores[i];
+      int idx = core->idxOfCurrent;
+      if ((-1 != idx) && (0 == s->state.remaining[idx]))
+      {
+         // I/O that would start as the simulation ends doesn't happen.
+         if ((NULL != s->processes.cycles) && (s->state.cycle[idx] < s->processes.cycleCount[idx]))
+         {
+            if (time >= s->runtime)
+            {
+               continue;
+            }
+            setProcessStartedIo(s, time, idx, core);
+         }
+         else
+         {
+            setProcessFinished(s, time, idx, core);
+         }
+         core->idxOfCurrent = -1;
+      }
+   }
+}
+
+// The core an arriving process is handed to. Ties go to the lowest
+// numbered core.
+cpuCore* leastLoadedCore(scheduler* s)
+{
+   cpuCore* target = &s->cores[0];
+   int targetLoad = MAX_INT;
+   int c;
+   for (c = 0; c < s->cpuCount; c++)
+   {
+      int load = readyCount(&s->cores[c]) + ((-1 != s->cores[c].idxOfCurrent) ? 1 : 0);
+      if (load < targetLoad)
+      {
+         target = &s->cores[c];
+         targetLoad = load;
+      }
+   }
+
+   return target;
+}
+
+// Number of queued processes a core won't get to at this time, which is
+// all of them unless it is about to pick a new process to run.
+int surplusCount(cpuCore* core, BOOL timeSliced)
+{
+   BOOL picking = (-1 == core->idxOfCurrent) || (timeSliced && !core->quantumRemaining);
+
+   return readyCount(core) - (picking ? 1 : 0);
+}
+
+// The core with the most surplus work, for an idle core to steal from.
+// With a single core there is never anyone to steal from.
+cpuCore* findStealVictim(scheduler* s, BOOL timeSliced)
+{
+   cpuCore* victim = NULL;
+   int victimCount = 0;
+   int c;
+   for (c = 0; c < s->cpuCount; c++)
+   {
+      if (surplusCount(&s->cores[c], timeSliced) > victimCount)
+      {
+         victim = &s->cores[c];
+         victimCount = surplusCount(victim, timeSliced);
+      }
+   }
+
+   return victim;
+}
+
+// Wrap up once the runtime is over.
+void finishSimulation(scheduler* s, long long time)
+{
+   // Determine if current process has finished.
+   // For when the process happens to finish at the last tick.
+   finishProcesses(s, time);
+
+   s->summary.endTime = time;
+
+   BOOL printStats = !s->silent || s->summaryOnly;
+   if (printStats)
+   {
+      printSchedulerFinished(s, time);
+   }
+   printFinalStats(s);
+   s->summary.processCount = s->streaming ? s->streamProcessesRead : s->processCount;
+   if (s->summaryOnly)
+   {
+      printAggregateStats(s);
+   }
+   if (printStats && (s->cpuCount > 1))
+   {
+      printCpuStats(s, time);
+   }
+   if (printStats && s->binaryTrace)
+   {
+      writeByte(s, TraceEnd);
+   }
+
+   if (NULL != s->metricsFile)
+   {
+      writeMetrics(s, time);
+   }
+
+   destroyCores(s);
+}
+
+/** Scheduling policies **/
+// A policy is a set of hooks, named after its prefix in foreach_schedulerType:
+//    <prefix>TimeSliced                 TRUE if a process only runs for a quantum at a time.
+//    <prefix>FastForward                TRUE if picking a lone process again when its quantum
+//                                       runs out changes nothing but the trace.
+//    <prefix>Arrive(s, core, idx)       A process becomes ready on a core: it arrived, was
+//                                       stolen, used up its quantum or was pre-empted.
+//    <prefix>ArriveAll(s, core, indices, count)
+//                                       Several processes arrive on a core at once.
+//    <prefix>PickNext(s, core)          Take the ready process the core runs next, or -1.
+//    <prefix>ShouldPreempt(s, core)     TRUE if a ready process should replace the running one.
+//    <prefix>Quantum(s, core)           Quantum of the process the core just picked.
+//    <prefix>QuantumExpired(s, core)    The running process used up its quantum.
+//    <prefix>BurstEnded(s, core)        The running process ran the rest of its burst and is
+//                                       about to finish or start its I/O.
+//    <prefix>AtEvent(s, time)           Called at each event, after quanta expire.
+//    <prefix>NextEvent(s, time)         The next time the policy itself needs an event, or
+//                                       the runtime.
+// The hooks are static inline and the driver loop is generated for each
+// policy by GENERATE_DRIVER, so a policy costs no indirect calls and the
+// hooks a policy doesn't need compile away.
+
+// Processes never pre-empt each other here, so the ready processes are
+// served in exactly the order they arrive.
+#define fcfsFastForward FALSE
+#define fcfsTimeSliced FALSE
+
+static inline void fcfsArrive(scheduler* s, cpuCore* core, int idx)
+{
+   if (!enqueue(&core->readyQueue, idx))
+   {
+      fprintf(stderr, "Out of memory for the run queue of CPU %d\n", core->id);
+      s->failed = TRUE;
+   }
+}
+
+static inline void fcfsArriveAll(scheduler* s, cpuCore* core, const int* indices, int count)
+{
+   if (!enqueueAll(&core->readyQueue, indices, count))
+   {
+      fprintf(stderr, "Out of memory for the run queue of CPU %d\n", core->id);
+      s->failed = TRUE;
+   }
+}
+
+static inline int fcfsPickNext(scheduler* s, cpuCore* core)
+{
+   return dequeue(&core->readyQueue);
+}
+
+static inline BOOL fcfsShouldPreempt(scheduler* s, cpuCore* core)
+{
+   return FALSE;
+}
+
+static inline long long fcfsQuantum(scheduler* s, cpuCore* core)
+{
+   return 0;
+}
+
+static inline void fcfsQuantumExpired(scheduler* s, cpuCore* core)
+{
+}
+
+static inline void fcfsBurstEnded(scheduler* s, cpuCore* core)
+{
+}
+
+static inline void fcfsAtEvent(scheduler* s, long long time)
+{
+}
+
+static inline long long fcfsNextEvent(scheduler* s, long long time)
+{
+   return s->runtime;
+}
+
+// Pre-emptive shortest job first. Ready processes that are not running are
+// kept in a heap ordered by their remaining burst time, so selection and
+// pre-emption only look at its top. The running processes only get
+// shorter, so they can only be pre-empted by an arrival or a process back
+// from I/O.
+#define sjfFastForward FALSE
+#define sjfTimeSliced FALSE
+
+static inline void sjfArrive(scheduler* s, cpuCore* core, int idx)
+{
+   heapPush(&core->readyHeap, idx, s->state.remaining[idx], s->processes.order[idx]);
+}
+
+static inline void sjfArriveAll(scheduler* s, cpuCore* core, const int* indices, int count)
+{
+   int i;
+   for (i = 0; i < count; i++)
+   {
+      sjfArrive(s, core, indices[i]);
+   }
+}
+
+static inline int sjfPickNext(scheduler* s, cpuCore* core)
+{
+   return heapPop(&core->readyHeap);
+}
+
+// The current process is pre-empted if a ready one is strictly shorter.
+static inline BOOL sjfShouldPreempt(scheduler* s, cpuCore* core)
+{
+   if (isHeapEmpty(&core->readyHeap))
+   {
+      return FALSE;
+   }
+
+   heapEntry running = { s->state.remaining[core->idxOfCurrent],
+                         s->processes.order[core->idxOfCurrent], core->idxOfCurrent };
+   return isShorterJob(heapPeek(&core->readyHeap), &running);
+}
+
+static inline long long sjfQuantum(scheduler* s, cpuCore* core)
+{
+   return 0;
+}
+
+static inline void sjfQuantumExpired(scheduler* s, cpuCore* core)
+{
+}
+
+static inline void sjfBurstEnded(scheduler* s, cpuCore* core)
+{
+}
+
+static inline void sjfAtEvent(scheduler* s, long long time)
+{
+}
+
+static inline long long sjfNextEvent(scheduler* s, long long time)
+{
+   return s->runtime;
+}
+
+// Round Robin: each process runs for a quantum, then goes to the back of
+// the queue if it still has work to do.
+#define rrTimeSliced TRUE
+#define rrFastForward TRUE
+
+static inline void rrArrive(scheduler* s, cpuCore* core, int idx)
+{
+   fcfsArrive(s, core, idx);
+}
+
+static inline void rrArriveAll(scheduler* s, cpuCore* core, const int* indices, int count)
+{
+   fcfsArriveAll(s, core, indices, count);
+}
+
+static inline int rrPickNext(scheduler* s, cpuCore* core)
+{
+   return dequeue(&core->readyQueue);
+}
+
+static inline BOOL rrShouldPreempt(scheduler* s, cpuCore* core)
+{
+   return FALSE;
+}
+
+static inline long long rrQuantum(scheduler* s, cpuCore* core)
+{
+   return s->quantum;
+}
+
+// The process stays current until the next one is picked, so it still
+// counts towards the load of its core while the arrivals are handed out.
+static inline void rrQuantumExpired(scheduler* s, cpuCore* core)
+{
+   rrArrive(s, core, core->idxOfCurrent);
+}
+
+static inline void rrBurstEnded(scheduler* s, cpuCore* core)
+{
+}
+
+static inline void rrAtEvent(scheduler* s, long long time)
+{
+}
+
+static inline long long rrNextEvent(scheduler* s, long long time)
+{
+   return s->runtime;
+}
+
+// Multilevel feedback queue. Processes arrive at the top level, and go
+// down a level each time they use up the quantum of their level. A core
+// runs the first process of its highest non-empty level, which pre-empts
+// a process of a lower level. A pre-empted process keeps its level and
+// gets a full quantum when it runs again, and so does a process back from
+// I/O. Every boost period, all processes go back to the top level.
+#define mlfqFastForward FALSE
+#define mlfqTimeSliced TRUE
+
+static inline void mlfqArrive(scheduler* s, cpuCore* core, int idx)
+{
+   int level = s->state.level[idx];
+   if (!enqueue(&core->levelQueues[level], idx))
+   {
+      fprintf(stderr, "Out of memory for the run queue of CPU %d\n", core->id);
+      s->failed = TRUE;
+      return;
+   }
+
+   core->levelMask |= 1ULL << level;
+   core->levelReady++;
+}
+
+static inline void mlfqArriveAll(scheduler* s, cpuCore* core, const int* indices, int count)
+{
+   int i;
+   for (i = 0; i < count; i++)
+   {
+      mlfqArrive(s, core, indices[i]);
+   }
+}
+
+static inline int mlfqPickNext(scheduler* s, cpuCore* core)
+{
+   if (0 == core->levelMask)
+   {
+      return -1;
+   }
+
+   int level = __builtin_ctzll(core->levelMask);
+   int idx = dequeue(&core->levelQueues[level]);
+   if (isEmpty(&core->levelQueues[level]))
+   {
+      core->levelMask &= ~(1ULL << level);
+   }
+   core->levelReady--;
+
+   return idx;
+}
+
+static inline BOOL mlfqShouldPreempt(scheduler* s, cpuCore* core)
+{
+   return (0 != core->levelMask) &&
+          (__builtin_ctzll(core->levelMask) < s->state.level[core->idxOfCurrent]);
+}
+
+static inline long long mlfqQuantum(scheduler* s, cpuCore* core)
+{
+   return (-1 != core->idxOfCurrent) ? s->levelQuanta[s->state.level[core->idxOfCurrent]] : 0;
+}
+
+static inline void mlfqQuantumExpired(scheduler* s, cpuCore* core)
+{
+   int idx = core->idxOfCurrent;
+   if (s->state.level[idx] < s->levelCount - 1)
+   {
+      s->state.level[idx]++;
+   }
+   mlfqArrive(s, core, idx);
+}
+
+static inline void mlfqBurstEnded(scheduler* s, cpuCore* core)
+{
+}
+
+// Move every process back to the top level, keeping the order of the
+// levels. Running processes finish their current quantum first.
+static inline void mlfqAtEvent(scheduler* s, long long time)
+{
+   if ((s->boostPeriod <= 0) || (0 == time) || (0 != time % s->boostPeriod))
+   {
+      return;
+   }
+
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      cpuCore* core = &s->cores[i];
+      int l;
+      for (l = 1; l < s->levelCount; l++)
+      {
+         int idx;
+         while (-1 != (idx = dequeue(&core->levelQueues[l])))
+         {
+            s->state.level[idx] = 0;
+            if (!enqueue(&core->levelQueues[0], idx))
+            {
+               fprintf(stderr, "Out of memory for the run queue of CPU %d\n", core->id);
+               s->failed = TRUE;
+            }
+         }
+      }
+
+      core->levelMask = (core->levelReady > 0) ? 1 : 0;
+      if (-1 != core->idxOfCurrent)
+      {
+         s->state.level[core->idxOfCurrent] = 0;
+      }
+   }
+}
+
+static inline long long mlfqNextEvent(scheduler* s, long long time)
+{
+   return (s->boostPeriod > 0) ? (time / s->boostPeriod + 1) * s->boostPeriod : s->runtime;
+}
+
+// Completely fair scheduling. Each core runs the ready process with the
+// least virtual runtime for a quantum. Running adds the time divided by the
+// weight of the process to its virtual runtime, so heavier processes get a
+// larger share of the core. A process that joins a core starts no lower
+// than the virtual runtime the core has reached.
+#define cfsFastForward FALSE
+#define cfsTimeSliced TRUE
+
+static inline void cfsArrive(scheduler* s, cpuCore* core, int idx)
+{
+   if (s->state.vruntime[idx] < core->minVruntime)
+   {
+      s->state.vruntime[idx] = core->minVruntime;
+   }
+   treeInsert(s, &core->tree, idx);
+}
+
+static inline void cfsArriveAll(scheduler* s, cpuCore* core, const int* indices, int count)
+{
+   int i;
+   for (i = 0; i < count; i++)
+   {
+      cfsArrive(s, core, indices[i]);
+   }
+}
+
+static inline int cfsPickNext(scheduler* s, cpuCore* core)
+{
+   int idx = treePopMin(s, &core->tree);
+   if ((-1 != idx) && (s->state.vruntime[idx] > core->minVruntime))
+   {
+      core->minVruntime = s->state.vruntime[idx];
+   }
+
+   return idx;
+}
+
+static inline BOOL cfsShouldPreempt(scheduler* s, cpuCore* core)
+{
+   return FALSE;
+}
+
+static inline long long cfsQuantum(scheduler* s, cpuCore* core)
+{
+   return s->quantum;
+}
+
+static inline void cfsQuantumExpired(scheduler* s, cpuCore* core)
+{
+   int idx = core->idxOfCurrent;
+   s->state.vruntime[idx] += s->quantum * VRUNTIME_SCALE / s->processes.weight[idx];
+   cfsArrive(s, core, idx);
+}
+
+// A burst can end part way through the quantum, and the process is only
+// charged for the ticks it ran.
+static inline void cfsBurstEnded(scheduler* s, cpuCore* core)
+{
+   int idx = core->idxOfCurrent;
+   s->state.vruntime[idx] += (s->quantum - core->quantumRemaining) * VRUNTIME_SCALE / s->processes.weight[idx];
+}
+
+static inline void cfsAtEvent(scheduler* s, long long time)
+{
+}
+
+static inline long long cfsNextEvent(scheduler* s, long long time)
+{
+   return s->runtime;
+}
+
+/** Scheduling algorithms **/
+// Each algorithm only visits the instants at which something can change
+// (an arrival, a completion or a quantum expiry) instead of every tick.
+// Between two events the selected processes cannot change, so all of the
+// ticks in between are applied in a single step by advanceTime().
+// Every core schedules the processes in its own run queue.
+//
+// At each event, in this order:
+//    a lone process may skip ahead through its quanta,
+//    the policy sees the bursts that ended, then finished processes leave
+//    their core, or start their I/O,
+//    processes out of quantum go back to the ready processes of their core,
+//    the policy handles events of its own,
+//    processes back from I/O go to the least loaded core,
+//    arrivals go to the least loaded core, all at once with a single core,
+//    idle cores without ready processes steal from the busiest core,
+//    then each core pre-empts its process or picks a new one if it has to.
+// The timing wheel then gives the next event, the earliest of the timers
+// of the cores, of the next arrival and of the policy.
+// A checkpoint or a snapshot of the run is taken between two events, and a
+// run resumed from one starts from the event it was taken at.
+// Only the selection of a process that is not currently running is logged.
+#define GENERATE_DRIVER(ENUM, PREFIX) \
+void run##ENUM(scheduler* s) \
+{ \
+   int i; \
+   int arrivalCursor = 0; \
+\
+   createCores(s); \
+\
+   long long time = restoreCheckpoint(s, &arrivalCursor); \
+   while (time < s->runtime) \
+   { \
+      if (s->checkpoint.logFd >= 0) \
+      { \
+         checkpointIfDue(s, time, arrivalCursor); \
+      } \
+      if ((s->snapshots.interval > 0) && (time >= s->snapshots.nextTime)) \
+      { \
+         takeSnapshot(s, time, arrivalCursor); \
+      } \
+      expireTimers(s, time); \
+      if (PREFIX##FastForward) \
+      { \
+         time = fastForwardLoneProcess(s, time, arrivalCursor); \
+      } \
+      for (i = 0; i < s->cpuCount; i++) \
+      { \
+         int idx = s->cores[i].idxOfCurrent; \
+         if ((-1 != idx) && (0 == s->state.remaining[idx])) \
+         { \
+            PREFIX##BurstEnded(s, &s->cores[i]); \
+         } \
+      } \
+      finishProcesses(s, time); \
+\
+      for (i = 0; i < s->cpuCount; i++) \
+      { \
+         cpuCore* core = &s->cores[i]; \
+         if (PREFIX##TimeSliced && !core->quantumRemaining && (-1 != core->idxOfCurrent)) \
+         { \
+            PREFIX##QuantumExpired(s, core); \
+         } \
+      } \
+      PREFIX##AtEvent(s, time); \
+\
+      int idx; \
+      expireTimers(s, time); \
+      while (!isEmpty(&s->waking)) \
+      { \
+         idx = dequeue(&s->waking); \
+         printProcessFinishedIo(s, time, idx); \
+         PREFIX##Arrive(s, leastLoadedCore(s), idx); \
+      } \
+      if ((1 == s->cpuCount) && !s->streaming) \
+      { \
+         int count = countArrivals(s, time, &arrivalCursor); \
+         for (i = 0; i < count; i++) \
+         { \
+            printProcessArrived(s, time, s->arrivalOrder[arrivalCursor + i]); \
+         } \
+         PREFIX##ArriveAll(s, &s->cores[0], &s->arrivalOrder[arrivalCursor], count); \
+         arrivalCursor += count; \
+      } \
+      else \
+      { \
+         while (-1 != (idx = nextArrivingProcess(s, time, &arrivalCursor))) \
+         { \
+            printProcessArrived(s, time, idx); \
+            PREFIX##Arrive(s, leastLoadedCore(s), idx); \
+         } \
+      } \
+      setTimer(s, ARRIVAL_TIMER(s), findNextArrival(s, arrivalCursor)); \
+\
+      for (i = 0; (s->cpuCount > 1) && (i < s->cpuCount); i++) \
+      { \
+         cpuCore* thief = &s->cores[i]; \
+         cpuCore* victim; \
+         if ((-1 == thief->idxOfCurrent) && (0 == readyCount(thief)) && \
+             (NULL != (victim = findStealVictim(s, PREFIX##TimeSliced)))) \
+         { \
+            idx = PREFIX##PickNext(s, victim); \
+            printProcessStolen(s, time, idx, thief, victim); \
+            PREFIX##Arrive(s, thief, idx); \
+         } \
+      } \
+\
+      for (i = 0; i < s->cpuCount; i++) \
+      { \
+         cpuCore* core = &s->cores[i]; \
+         BOOL picking = (-1 == core->idxOfCurrent) || (PREFIX##TimeSliced && !core->quantumRemaining); \
+         if (!picking && PREFIX##ShouldPreempt(s, core)) \
+         { \
+            int preempted = core->idxOfCurrent; \
+            core->idxOfCurrent = PREFIX##PickNext(s, core); \
+            PREFIX##Arrive(s, core, preempted); \
+            setProcessSelected(s, time, core); \
+            if (PREFIX##TimeSliced) \
+            { \
+               core->quantumRemaining = PREFIX##Quantum(s, core); \
+            } \
+         } \
+         else if (picking) \
+         { \
+            core->idxOfCurrent = PREFIX##PickNext(s, core); \
+            if (-1 != core->idxOfCurrent) \
+            { \
+               setProcessSelected(s, time, core); \
+            } \
+            if (PREFIX##TimeSliced) \
+            { \
+               core->quantumRemaining = PREFIX##Quantum(s, core); \
+            } \
+         } \
+         setCoreTimer(s, core, time, PREFIX##TimeSliced); \
+      } \
+\
+      setTimer(s, POLICY_TIMER(s), PREFIX##NextEvent(s, time)); \
+      long long nextEvent = wheelNextBefore(&s->timers, s->runtime); \
+      advanceTime(s, time, nextEvent); \
+      time = nextEvent; \
+   } \
+\
+   finishSimulation(s, time); \
+}
+
+foreach_schedulerType(GENERATE_DRIVER)
+
+/** Metrics **/
+// Add the time until the next event to the bucket of the current number of
+// ready processes.
+void recordQueueDepth(scheduler* s, long long elapsed)
+{
+   runMetrics* m = &s->metrics;
+   long long depth = 0;
+
+   int i;
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      depth += readyCount(&s->cores[i]);
+   }
+
+   int bucket = (depth > 0) ? (64 - __builtin_clzll(depth)) : 0;
+   m->depthTime[bucket] += elapsed;
+   m->depthArea += depth * elapsed;
+   if (depth > m->maxDepth)
+   {
+      m->maxDepth = depth;
+   }
+}
+
+void recordProcessFinished(scheduler* s, long long wait, long long turnaround)
+{
+   runMetrics* m = &s->metrics;
+
+   if (m->sampleCount == m->sampleCapacity)
+   {
+      m->sampleCapacity = (m->sampleCapacity > 0) ? (2 * m->sampleCapacity) : 1024;
+      m->waits = realloc(m->waits, m->sampleCapacity * sizeof(long long));
+      m->turnarounds = realloc(m->turnarounds, m->sampleCapacity * sizeof(long long));
+   }
+
+   m->waits[m->sampleCount] = wait;
+   m->turnarounds[m->sampleCount] = turnaround;
+   m->sampleCount++;
+}
+
+// Write the metrics once the simulation has ended, while the cores still
+// hold their busy times.
+void writeMetrics(scheduler* s, long long time)
+{
+   runMetrics* m = &s->metrics;
+
+   qsort(m->waits, m->sampleCount, sizeof(long long), compareTimes);
+   qsort(m->turnarounds, m->sampleCount, sizeof(long long), compareTimes);
+
+   if (MetricsCsv == s->metricsFormat)
+   {
+      writeCsvMetrics(s, s->metricsFile, time);
+   }
+   else
+   {
+      writeJsonMetrics(s, s->metricsFile, time);
+   }
+
+   if (0 != fflush(s->metricsFile))
+   {
+      fprintf(stderr, "Can't write the metrics file\n");
+      s->failed = TRUE;
+   }
+}
+
+double elapsedSince(struct timespec* start)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void writeJsonMetrics(scheduler* s, FILE* f, long long time)
+{
+   runMetrics* m = &s->metrics;
+   long long busy = 0;
+   int i;
+
+   fprintf(f, "{\n");
+   fprintf(f, "  \"algorithm\": \"%s\",\n", schedulerTypeString[s->schedulerType]);
+   fprintf(f, "  \"processes\": %d,\n", s->summary.processCount);
+   fprintf(f, "  \"finished\": %d,\n", s->summary.finishedCount);
+   fprintf(f, "  \"end_time\": %lld,\n", time);
+   fprintf(f, "  \"context_switches\": %lld,\n", s->summary.contextSwitches);
+   fprintf(f, "  \"cpus\": [\n");
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      busy += s->cores[i].busyTime;
+      fprintf(f, "    { \"id\": %d, \"busy\": %lld, \"idle\": %lld, \"utilization\": %.6f }%s\n",
+              i, s->cores[i].busyTime, time - s->cores[i].busyTime,
+              (time > 0) ? (double) s->cores[i].busyTime / time : 0.0,
+              (i + 1 < s->cpuCount) ? "," : "");
+   }
+   fprintf(f, "  ],\n");
+   fprintf(f, "  \"idle_time\": %lld,\n", time * s->cpuCount - busy);
+   fprintf(f, "  \"utilization\": %.6f,\n", (time > 0) ? (double) busy / ((double) time * s->cpuCount) : 0.0);
+   fprintf(f, "  \"ready_queue\": {\n");
+   fprintf(f, "    \"max\": %lld,\n", m->maxDepth);
+   fprintf(f, "    \"mean\": %.6f,\n", averageOf(m->depthArea, time));
+   fprintf(f, "    \"histogram\": [");
+   BOOL first = TRUE;
+   for (i = 0; i < DEPTH_BUCKETS; i++)
+   {
+      if (m->depthTime[i] > 0)
+      {
+         fprintf(f, "%s\n      { \"min\": %lld, \"max\": %lld, \"time\": %lld }", first ? "" : ",",
+                 (i > 0) ? (1LL << (i - 1)) : 0LL, (i > 0) ? ((1LL << (i - 1)) * 2 - 1) : 0LL, m->depthTime[i]);
+         first = FALSE;
+      }
+   }
+   fprintf(f, "\n    ]\n  },\n");
+   fprintf(f, "  \"wait\": { \"mean\": %.6f, \"p50\": %lld, \"p95\": %lld, \"p99\": %lld },\n",
+           averageOf(s->summary.totalWait, s->summary.finishedCount), percentile(m->waits, m->sampleCount, 50),
+           percentile(m->waits, m->sampleCount, 95), percentile(m->waits, m->sampleCount, 99));
+   fprintf(f, "  \"turnaround\": { \"mean\": %.6f, \"p50\": %lld, \"p95\": %lld, \"p99\": %lld },\n",
+           averageOf(s->summary.totalTurnaround, s->summary.finishedCount), percentile(m->turnarounds, m->sampleCount, 50),
+           percentile(m->turnarounds, m->sampleCount, 95), percentile(m->turnarounds, m->sampleCount, 99));
+   fprintf(f, "  \"throughput\": %.6f,\n", averageOf(s->summary.finishedCount, time));
+   fprintf(f, "  \"wall_clock_seconds\": %.6f,\n", elapsedSince(&m->startTime));
+   fprintf(f, "  \"events\": %lld\n", s->summary.events);
+   fprintf(f, "}\n");
+}
+
+// One metric per row, so that rows can be added without breaking readers.
+void writeCsvMetrics(scheduler* s, FILE* f, long long time)
+{
+   runMetrics* m = &s->metrics;
+   long long busy = 0;
+   int i;
+
+   fprintf(f, "metric,value\n");
+   fprintf(f, "algorithm,%s\n", schedulerTypeString[s->schedulerType]);
+   fprintf(f, "processes,%d\n", s->summary.processCount);
+   fprintf(f, "finished,%d\n", s->summary.finishedCount);
+   fprintf(f, "end_time,%lld\n", time);
+   fprintf(f, "context_switches,%lld\n", s->summary.contextSwitches);
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      busy += s->cores[i].busyTime;
+      fprintf(f, "cpu%d_busy,%lld\n", i, s->cores[i].busyTime);
+      fprintf(f, "cpu%d_idle,%lld\n", i, time - s->cores[i].busyTime);
+      fprintf(f, "cpu%d_utilization,%.6f\n", i, (time > 0) ? (double) s->cores[i].busyTime / time : 0.0);
+   }
+   fprintf(f, "idle_time,%lld\n", time * s->cpuCount - busy);
+   fprintf(f, "utilization,%.6f\n", (time > 0) ? (double) busy / ((double) time * s->cpuCount) : 0.0);
+   fprintf(f, "ready_queue_max,%lld\n", m->maxDepth);
+   fprintf(f, "ready_queue_mean,%.6f\n", averageOf(m->depthArea, time));
+   for (i = 0; i < DEPTH_BUCKETS; i++)
+   {
+      if (m->depthTime[i] > 0)
+      {
+         fprintf(f, "ready_queue_time_%lld_%lld,%lld\n",
+                 (i > 0) ? (1LL << (i - 1)) : 0LL, (i > 0) ? ((1LL << (i - 1)) * 2 - 1) : 0LL, m->depthTime[i]);
+      }
+   }
+   fprintf(f, "wait_mean,%.6f\n", averageOf(s->summary.totalWait, s->summary.finishedCount));
+   fprintf(f, "wait_p50,%lld\n", percentile(m->waits, m->sampleCount, 50));
+   fprintf(f, "wait_p95,%lld\n", percentile(m->waits, m->sampleCount, 95));
+   fprintf(f, "wait_p99,%lld\n", percentile(m->waits, m->sampleCount, 99));
+   fprintf(f, "turnaround_mean,%.6f\n", averageOf(s->summary.totalTurnaround, s->summary.finishedCount));
+   fprintf(f, "turnaround_p50,%lld\n", percentile(m->turnarounds, m->sampleCount, 50));
+   fprintf(f, "turnaround_p95,%lld\n", percentile(m->turnarounds, m->sampleCount, 95));
+   fprintf(f, "turnaround_p99,%lld\n", percentile(m->turnarounds, m->sampleCount, 99));
+   fprintf(f, "throughput,%.6f\n", averageOf(s->summary.finishedCount, time));
+   fprintf(f, "wall_clock_seconds,%.6f\n", elapsedSince(&m->startTime));
+   fprintf(f, "events,%lld\n", s->summary.events);
+}
+
+int compareTimes(const void* a, const void* b)
+{
+   long long timeA = *(const long long*) a;
+   long long timeB = *(const long long*) b;
+
+   return (timeA > timeB) - (timeA < timeB);
+}
+
+// Nearest-rank percentile of sorted samples, or 0 without any.
+long long percentile(long long* sorted, int count, int percent)
+{
+   if (0 == count)
+   {
+      return 0;
+   }
+
+   long long rank = ((long long) count * percent + 99) / 100;
+   return sorted[(rank > 0) ? (rank - 1) : 0];
+}
+
+double averageOf(long long total, long long count)
+{
+   return (count > 0) ? (double) total / count : 0.0;
+}
+
+/** Checkpoints **/
+// Open the log of finished processes. When resuming, check the checkpoint
+// and cut the output back to what it covers, since the run writes the rest
+// again. A run resumed without a checkpoint starts over.
+int openCheckpoint(scheduler* s)
+{
+   checkpointState* c = &s->checkpoint;
+   checkpointBuffer* b = &c->buffer;
+   unsigned long long outputLength = 0;
+
+   c->fingerprint = fingerprintRun(s);
+   if (c->resume && !readWholeFile(c->fileName, b))
+   {
+      if (ENOENT != errno)
+      {
+         fprintf(stderr, "Can't read checkpoint %s\n", c->fileName);
+         return -1;
+      }
+      c->resume = FALSE;
+   }
+
+   if (c->resume)
+   {
+      // The checkpoint ends with a hash of everything before it, so one
+      // that is damaged is caught before any of it is used.
+      unsigned long long checksum = 0;
+      BOOL valid = (b->length >= CHECKPOINT_MAGIC_LENGTH + sizeof(checksum));
+      if (valid)
+      {
+         b->length -= sizeof(checksum);
+         memcpy(&checksum, b->data + b->length, sizeof(checksum));
+         valid = (0 == memcmp(b->data, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH)) &&
+                 (checksum == hashBytes(HASH_OFFSET, b->data, b->length));
+      }
+      if (!valid)
+      {
+         fprintf(stderr, "%s is not a checkpoint or is damaged\n", c->fileName);
+         return -1;
+      }
+
+      b->position = CHECKPOINT_MAGIC_LENGTH;
+      if ((CHECKPOINT_VERSION != getCheckpointVarint(b)) || (c->fingerprint != getCheckpointVarint(b)))
+      {
+         fprintf(stderr, "Checkpoint %s is of another version, input or settings\n", c->fileName);
+         return -1;
+      }
+      c->logLength = getCheckpointVarint(b);
+      outputLength = getCheckpointVarint(b);
+   }
+   else
+   {
+      // A checkpoint left from an earlier run would no longer match the log.
+      unlink(c->fileName);
+   }
+
+   struct stat info;
+   c->logFd = open(c->logName, O_WRONLY | O_CREAT | (c->resume ? 0 : O_TRUNC), 0644);
+   if ((c->logFd < 0) || (fstat(c->logFd, &info) < 0) || (info.st_size < c->logLength) ||
+       (ftruncate(c->logFd, c->logLength) < 0) || (lseek(c->logFd, c->logLength, SEEK_SET) < 0))
+   {
+      fprintf(stderr, "Can't open the log of checkpoint %s\n", c->fileName);
+      return -1;
+   }
+
+   flushOutput(s);
+   if ((ftruncate(s->output.fd, outputLength) < 0) || (lseek(s->output.fd, outputLength, SEEK_SET) < 0))
+   {
+      fprintf(stderr, "The output of a checkpointed run must be a file\n");
+      return -1;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &c->lastWrite);
+   c->countdown = CHECKPOINT_CHECK_EVENTS;
+   return 0;
+}
+
+// Stop writing checkpoints. The last one written stays in place.
+void closeCheckpoint(scheduler* s)
+{
+   checkpointState* c = &s->checkpoint;
+   if (c->logFd >= 0)
+   {
+      close(c->logFd);
+      c->logFd = -1;
+   }
+
+   free(c->finished.data);
+   memset(&c->finished, 0, sizeof(checkpointBuffer));
+   free(c->buffer.data);
+   memset(&c->buffer, 0, sizeof(checkpointBuffer));
+}
+
+// The record of a finished process is made as it finishes, while what it
+// needs is at hand, so a checkpoint only has to write the records out.
+void noteProcessFinished(checkpointBuffer* log, int idx, long long time)
+{
+   putCheckpointVarint(log, idx);
+   putCheckpointVarint(log, time);
+}
+
+// Looking at the clock at every event would cost more than most events, so
+// it is only looked at every so many of them.
+void checkpointIfDue(scheduler* s, long long time, int arrivalCursor)
+{
+   checkpointState* c = &s->checkpoint;
+   if (--c->countdown > 0)
+   {
+      return;
+   }
+
+   c->countdown = CHECKPOINT_CHECK_EVENTS;
+   if (elapsedSince(&c->lastWrite) >= CHECKPOINT_INTERVAL)
+   {
+      writeCheckpoint(s, time, arrivalCursor);
+   }
+}
+
+// Save the run as it is before the event at the given time. The processes
+// that finished since the last checkpoint go to the end of the log, then a
+// new state replaces the last one.
+void writeCheckpoint(scheduler* s, long long time, int arrivalCursor)
+{
+   checkpointState* c = &s->checkpoint;
+   checkpointBuffer* b = &c->buffer;
+
+   BOOL saved = !c->finished.failed && writeWholeFile(c->logFd, c->finished.data, c->finished.length);
+   c->logLength += c->finished.length;
+   c->finished.length = 0;
+
+   // The checkpoint covers everything written to the output so far.
+   flushOutput(s);
+   off_t outputLength = lseek(s->output.fd, 0, SEEK_CUR);
+
+   b->length = 0;
+   b->failed = FALSE;
+   putCheckpointBytes(b, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH);
+   putCheckpointVarint(b, CHECKPOINT_VERSION);
+   putCheckpointVarint(b, c->fingerprint);
+   putCheckpointVarint(b, c->logLength);
+   putCheckpointVarint(b, outputLength);
+   saveRunState(s, b, time, arrivalCursor);
+
+   unsigned long long checksum = hashBytes(HASH_OFFSET, b->data, b->length);
+   putCheckpointBytes(b, &checksum, sizeof(checksum));
+
+   // The new state only takes the place of the last one once it is all
+   // written, so there is always a whole checkpoint to resume from.
+   int fd = open(c->tempName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   saved = saved && !b->failed && !s->failed && (outputLength >= 0) && (fd >= 0) &&
+           writeWholeFile(fd, b->data, b->length);
+   if ((fd >= 0) && (close(fd) < 0))
+   {
+      saved = FALSE;
+   }
+   if (!saved || (rename(c->tempName, c->fileName) < 0))
+   {
+      fprintf(stderr, "Can't write checkpoint %s, so the run goes on without checkpoints\n", c->fileName);
+      closeCheckpoint(s);
+      return;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &c->lastWrite);
+}
+
+// Add the state of the run before the event at the given time to a buffer.
+// Only the cores and the processes on them or in I/O are in it, so it stays
+// small however long the run is.
+void saveRunState(scheduler* s, checkpointBuffer* b, long long time, int arrivalCursor)
+{
+   timerWheel* w = &s->timers;
+   int i;
+   int k;
+
+   putCheckpointSigned(b, time);
+   putCheckpointVarint(b, arrivalCursor);
+   putCheckpointSigned(b, s->traceTime);
+   putCheckpointVarint(b, s->summary.finishedCount);
+   putCheckpointSigned(b, s->summary.totalWait);
+   putCheckpointVarint(b, s->summary.totalIoWait);
+   putCheckpointSigned(b, s->summary.totalTurnaround);
+   putCheckpointVarint(b, s->summary.contextSwitches);
+   putCheckpointVarint(b, s->summary.events);
+   for (i = 0; i < DEPTH_BUCKETS; i++)
+   {
+      putCheckpointVarint(b, s->metrics.depthTime[i]);
+   }
+   putCheckpointVarint(b, s->metrics.depthArea);
+   putCheckpointVarint(b, s->metrics.maxDepth);
+   putCheckpointVarint(b, elapsedSince(&s->metrics.startTime) * 1e9);
+
+   // The ready processes of each core are listed in the order they have to
+   // go back in: first to last for a queue, and any order for the heap and
+   // the tree, which order them by themselves.
+   for (i = 0; i < s->cpuCount; i++)
+   {
+      cpuCore* core = &s->cores[i];
+      putCheckpointVarint(b, -1 != core->idxOfCurrent);
+      if (-1 != core->idxOfCurrent)
+      {
+         putProcessState(s, b, core->idxOfCurrent);
+      }
+      putCheckpointVarint(b, core->lastOrder + 1);
+      putCheckpointSigned(b, core->quantumRemaining);
+      putCheckpointVarint(b, core->busyTime);
+      putCheckpointSigned(b, core->minVruntime);
+
+      unsigned int position;
+      putCheckpointVarint(b, queueCount(&core->readyQueue));
+      for (position = core->readyQueue.head; position != core->readyQueue.tail; position++)
+      {
+         putProcessState(s, b, core->readyQueue.array[position & core->readyQueue.mask]);
+      }
+
+      putCheckpointVarint(b, core->readyHeap.size);
+      for (k = 0; k < core->readyHeap.size; k++)
+      {
+         putProcessState(s, b, core->readyHeap.array[k].idx);
+         putCheckpointSigned(b, core->readyHeap.array[k].burst);
+      }
+
+      for (k = 0; (NULL != core->levelQueues) && (k < s->levelCount); k++)
+      {
+         integerQueue* q = &core->levelQueues[k];
+         putCheckpointVarint(b, queueCount(q));
+         for (position = q->head; position != q->tail; position++)
+         {
+            putProcessState(s, b, q->array[position & q->mask]);
+         }
+      }
+
+      putCheckpointVarint(b, core->tree.size);
+      for (k = core->tree.leftmost; -1 != k; k = treeNext(s, k))
+      {
+         putProcessState(s, b, k);
+      }
+   }
+
+   // Then the processes in I/O and when it is done. Timers that go off at
+   // the same time are in the same slot of the wheel, in the order they go
+   // off, so they are listed in that order.
+   int blocked = 0;
+   int id;
+   for (k = 0; k < WHEEL_LEVELS * WHEEL_SLOTS; k++)
+   {
+      for (id = w->first[k]; -1 != id; id = w->next[id])
+      {
+         blocked += (id >= IO_TIMER(s, 0)) ? 1 : 0;
+      }
+   }
+   putCheckpointVarint(b, blocked);
+   for (k = 0; k < WHEEL_LEVELS * WHEEL_SLOTS; k++)
+   {
+      for (id = w->first[k]; -1 != id; id = w->next[id])
+      {
+         if (id >= IO_TIMER(s, 0))
+         {
+            putProcessState(s, b, id - IO_TIMER(s, 0));
+            putCheckpointSigned(b, w->when[id]);
+         }
+      }
+   }
+}
+
+// Put the run back in a state saved by saveRunState() and return the time
+// it was saved at. The cores must be empty.
+long long loadRunState(scheduler* s, checkpointBuffer* b, int* arrivalCursor)
+{
+   int i;
+   int k;
+   int idx;
+   long long time = getCheckpointSigned(b);
+   *arrivalCursor = getCheckpointVarint(b);
+   s->traceTime = getCheckpointSigned(b);
+   s->summary.finishedCount = getCheckpointVarint(b);
+   s->summary.totalWait = getCheckpointSigned(b);
+   s->summary.totalIoWait = getCheckpointVarint(b);
+   s->summary.totalTurnaround = getCheckpointSigned(b);
+   s->summary.contextSwitches = getCheckpointVarint(b);
+   s->summary.events = getCheckpointVarint(b);
+   for (i = 0; i < DEPTH_BUCKETS; i++)
+   {
+      s->metrics.depthTime[i] = getCheckpointVarint(b);
+   }
+   s->metrics.depthArea = getCheckpointVarint(b);
+   s->metrics.maxDepth = getCheckpointVarint(b);
+
+   // The wall-clock time of the run counts the time before the state.
+   long long elapsed = getCheckpointVarint(b);
+   s->metrics.startTime.tv_sec -= elapsed / 1000000000;
+   s->metrics.startTime.tv_nsec -= elapsed % 1000000000;
+   if (s->metrics.startTime.tv_nsec < 0)
+   {
+      s->metrics.startTime.tv_nsec += 1000000000;
+      s->metrics.startTime.tv_sec--;
+   }
+
+   for (i = 0; (i < s->cpuCount) && !b->failed; i++)
+   {
+      cpuCore* core = &s->cores[i];
+      core->idxOfCurrent = getCheckpointVarint(b) ? getProcessState(s, b) : -1;
+      core->lastOrder = (int) getCheckpointVarint(b) - 1;
+      core->quantumRemaining = getCheckpointSigned(b);
+      core->busyTime = getCheckpointVarint(b);
+      core->minVruntime = getCheckpointSigned(b);
+
+      int count = getCheckpointVarint(b);
+      for (k = 0; (k < count) && (-1 != (idx = getProcessState(s, b))); k++)
+      {
+         b->failed |= !enqueue(&core->readyQueue, idx);
+      }
+
+      count = getCheckpointVarint(b);
+      for (k = 0; (k < count) && (-1 != (idx = getProcessState(s, b))); k++)
+      {
+         heapPush(&core->readyHeap, idx, getCheckpointSigned(b), s->processes.order[idx]);
+      }
+
+      int l;
+      for (l = 0; (NULL != core->levelQueues) && (l < s->levelCount); l++)
+      {
+         count = getCheckpointVarint(b);
+         for (k = 0; (k < count) && (-1 != (idx = getProcessState(s, b))); k++)
+         {
+            b->failed |= !enqueue(&core->levelQueues[l], idx);
+            core->levelMask |= 1ULL << l;
+            core->levelReady++;
+         }
+      }
+
+      count = getCheckpointVarint(b);
+      for (k = 0; (k < count) && (-1 != (idx = getProcessState(s, b))); k++)
+      {
+         treeInsert(s, &core->tree, idx);
+      }
+   }
+
+   int blocked = getCheckpointVarint(b);
+   for (k = 0; (k < blocked) && (-1 != (idx = getProcessState(s, b))); k++)
+   {
+      scheduleIo(s, idx, getCheckpointSigned(b));
+   }
+   if (b->position != b->length)
+   {
+      b->failed = TRUE;
+   }
+
+   return time;
+}
+
+// Put a resumed run back in the state of its checkpoint, or a what-if run
+// in the state of its snapshot, and return the time of the event it was
+// saved before. Any other run starts at 0.
+long long restoreCheckpoint(scheduler* s, int* arrivalCursor)
+{
+   checkpointState* c = &s->checkpoint;
+   checkpointBuffer* b = &c->buffer;
+   runSnapshot* snapshot = s->snapshots.from;
+   long long time;
+   if (NULL != snapshot)
+   {
+      checkpointBuffer state = snapshot->state;
+      time = loadRunState(s, &state, arrivalCursor);
+      if (state.failed || !applyFinishLog(s, &s->snapshots.log))
+      {
+         fprintf(stderr, "Can't restore the snapshot at time %lld\n", snapshot->time);
+         s->failed = TRUE;
+         return s->runtime;
+      }
+      return time;
+   }
+   if (!c->resume)
+   {
+      return 0;
+   }
+
+   time = loadRunState(s, b, arrivalCursor);
+   if (b->failed || !readCheckpointLog(s, c->logLength))
+   {
+      fprintf(stderr, "Can't resume from checkpoint %s\n", c->fileName);
+      s->failed = TRUE;
+      return s->runtime;
+   }
+
+   return time;
+}
+
+// Read the part of the log the checkpoint covers.
+BOOL readCheckpointLog(scheduler* s, long long length)
+{
+   checkpointBuffer log;
+   memset(&log, 0, sizeof(checkpointBuffer));
+   BOOL valid = readWholeFile(s->checkpoint.logName, &log) && (log.length >= (size_t) length);
+
+   log.length = length;
+   valid = valid && applyFinishLog(s, &log);
+   free(log.data);
+   return valid;
+}
+
+// Mark the processes in a log as finished when they did.
+BOOL applyFinishLog(scheduler* s, checkpointBuffer* log)
+{
+   while (!log->failed && (log->position < log->length))
+   {
+      unsigned long long idx = getCheckpointVarint(log);
+      long long endTime = getCheckpointVarint(log);
+      if (idx >= (unsigned long long) s->processCount)
+      {
+         return FALSE;
+      }
+
+      s->state.endTime[idx] = endTime;
+      if (NULL != s->metricsFile)
+      {
+         process p = loadProcess(&s->processes, idx);
+         long long cpuTime = p.burst;
+         long long ioTime = 0;
+         addCycleTimes(&p, &cpuTime, &ioTime);
+         recordProcessFinished(s, endTime - p.arrival - cpuTime - ioTime, endTime - p.arrival);
+      }
+   }
+
+   return !log->failed;
+}
+
+// Hash everything the run depends on: its settings, how it writes its
+// results and its processes.
+unsigned long long fingerprintRun(scheduler* s)
+{
+   unsigned long long hash = HASH_OFFSET;
+   hash = hashNumber(hash, s->processCount);
+   hash = hashNumber(hash, s->runtime);
+   hash = hashNumber(hash, s->schedulerType);
+   hash = hashNumber(hash, s->quantum);
+   hash = hashNumber(hash, s->cpuCount);
+   hash = hashNumber(hash, s->levelCount);
+   hash = hashNumber(hash, s->boostPeriod);
+   hash = hashNumber(hash, s->summaryOnly);
+   hash = hashNumber(hash, s->binaryTrace);
+   hash = hashNumber(hash, NULL != s->metricsFile);
+
+   int i;
+   for (i = 0; (i < s->levelCount) && (i < MAX_LEVELS); i++)
+   {
+      hash = hashNumber(hash, s->levelQuanta[i]);
+   }
+
+   for (i = 0; i < s->processCount; i++)
+   {
+      process p = loadProcess(&s->processes, i);
+      hash = hashBytes(hash, p.name, p.nameLength);
+      hash = hashNumber(hash, p.arrival);
+      hash = hashNumber(hash, p.burst);
+      hash = hashNumber(hash, p.weight);
+      hash = hashNumber(hash, p.cycleCount);
+      hash = hashBytes(hash, p.cycles, 2 * p.cycleCount * sizeof(long long));
+   }
+
+   return hash;
+}
+
+// 64-bit FNV-1a.
+unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size)
+{
+   const unsigned char* bytes = data;
+   size_t i;
+   for (i = 0; i < size; i++)
+   {
+      hash = (hash ^ bytes[i]) * HASH_PRIME;
+   }
+
+   return hash;
+}
+
+// Numbers go in a whole word at a time, which is enough to tell runs apart.
+unsigned long long hashNumber(unsigned long long hash, long long val)
+{
+   return (hash ^ (unsigned long long) val) * HASH_PRIME;
+}
+
+// Read a whole file into a buffer. Returns FALSE with errno set if it can't.
+BOOL readWholeFile(const char* fileName, checkpointBuffer* b)
+{
+   int fd = open(fileName, O_RDONLY);
+   if (fd < 0)
+   {
+      return FALSE;
+   }
+
+   struct stat info;
+   BOOL valid = (fstat(fd, &info) >= 0);
+   if (valid && ((size_t) info.st_size > b->capacity))
+   {
+      unsigned char* data = realloc(b->data, info.st_size);
+      valid = (NULL != data);
+      if (valid)
+      {
+         b->data = data;
+         b->capacity = info.st_size;
+      }
+   }
+
+   b->length = 0;
+   b->position = 0;
+   b->failed = FALSE;
+   while (valid && (b->length < (size_t) info.st_size))
+   {
+      ssize_t count = read(fd, b->data + b->length, info.st_size - b->length);
+      if ((count < 0) && (EINTR == errno))
+      {
+         continue;
+      }
+      if (count <= 0)
+      {
+         errno = (count < 0) ? errno : EIO;
+         valid = FALSE;
+         break;
+      }
+      b->length += count;
+   }
+
+   close(fd);
+   return valid;
+}
+
+BOOL writeWholeFile(int fd, const unsigned char* data, size_t size)
+{
+   while (size > 0)
+   {
+      ssize_t written = write(fd, data, size);
+      if ((written < 0) && (EINTR == errno))
+      {
+         continue;
+      }
+      if (written < 0)
+      {
+         return FALSE;
+      }
+      data += written;
+      size -= written;
+   }
+
+   return TRUE;
+}
+
+void putCheckpointBytes(checkpointBuffer* b, const void* data, size_t size)
+{
+   if (b->length + size > b->capacity)
+   {
+      size_t capacity = (b->capacity > 0) ? (2 * b->capacity) : 4096;
+      while (capacity < b->length + size)
+      {
+         capacity *= 2;
+      }
+
+      unsigned char* grown = realloc(b->data, capacity);
+      if (NULL == grown)
+      {
+         b->failed = TRUE;
+         return;
+      }
+      b->data = grown;
+      b->capacity = capacity;
+   }
+
+   memcpy(b->data + b->length, data, size);
+   b->length += size;
+}
+
+void putCheckpointVarint(checkpointBuffer* b, unsigned long long val)
+{
+   unsigned char bytes[10];
+   int length = 0;
+   while (val >= 0x80)
+   {
+      bytes[length++] = (val & 0x7F) | 0x80;
+      val >>= 7;
+   }
+   bytes[length++] = val;
+
+   putCheckpointBytes(b, bytes, length);
+}
+
+void putCheckpointSigned(checkpointBuffer* b, long long val)
+{
+   putCheckpointVarint(b, ((unsigned long long) val << 1) ^ (unsigned long long) (val >> 63));
+}
+
+// Returns 0 once the buffer runs out.
+unsigned long long getCheckpointVarint(checkpointBuffer* b)
+{
+   unsigned long long val = 0;
+   int shift = 0;
+   unsigned char byte;
+
+   do
+   {
+      if (b->position >= b->length)
+      {
+         b->failed = TRUE;
+         return 0;
+      }
+      byte = b->data[b->position++];
+      val |= (unsigned long long) (byte & 0x7F) << shift;
+      shift += 7;
+   } while ((byte & 0x80) && (shift < 64));
+
+   return val;
+}
+
+long long getCheckpointSigned(checkpointBuffer* b)
+{
+   unsigned long long val = getCheckpointVarint(b);
+   return (long long) (val >> 1) ^ -(long long) (val & 1);
+}
+
+// What a live process has done so far: the burst it has left, and its
+// level, virtual runtime and I/O cycle when the run keeps them.
+void putProcessState(scheduler* s, checkpointBuffer* b, int idx)
+{
+   putCheckpointVarint(b, idx);
+   putCheckpointSigned(b, s->state.remaining[idx]);
+   if (NULL != s->state.level)
+   {
+      putCheckpointVarint(b, s->state.level[idx]);
+   }
+   if (NULL != s->state.vruntime)
+   {
+      putCheckpointSigned(b, s->state.vruntime[idx]);
+   }
+   if (NULL != s->state.cycle)
+   {
+      putCheckpointVarint(b, s->state.cycle[idx]);
+   }
+}
+
+// Returns the index of the process, or -1 if the checkpoint doesn't hold one.
+int getProcessState(scheduler* s, checkpointBuffer* b)
+{
+   unsigned long long idx = getCheckpointVarint(b);
+   if (b->failed || (idx >= (unsigned long long) s->processCount))
+   {
+      b->failed = TRUE;
+      return -1;
+   }
+
+   s->state.remaining[idx] = getCheckpointSigned(b);
+   if (NULL != s->state.level)
+   {
+      s->state.level[idx] = getCheckpointVarint(b);
+   }
+   if (NULL != s->state.vruntime)
+   {
+      s->state.vruntime[idx] = getCheckpointSigned(b);
+   }
+   if (NULL != s->state.cycle)
+   {
+      s->state.cycle[idx] = getCheckpointVarint(b);
+   }
+
+   return idx;
+}
+
+/** What-if runs **/
+// Snapshots are taken at the first event of each interval.
+void takeSnapshot(scheduler* s, long long time, int arrivalCursor)
+{
+   snapshotState* snapshots = &s->snapshots;
+   if (snapshots->count == snapshots->capacity)
+   {
+      int capacity = (snapshots->capacity > 0) ? (2 * snapshots->capacity) : 64;
+      runSnapshot* list = realloc(snapshots->list, capacity * sizeof(runSnapshot));
+      if (NULL == list)
+      {
+         fprintf(stderr, "Out of memory for snapshots, so the run goes on without them\n");
+         snapshots->interval = 0;
+         return;
+      }
+      snapshots->list = list;
+      snapshots->capacity = capacity;
+   }
+
+   runSnapshot* snapshot = &snapshots->list[snapshots->count];
+   memset(snapshot, 0, sizeof(runSnapshot));
+   snapshot->time = time;
+   snapshot->logLength = snapshots->log.length;
+   saveRunState(s, &snapshot->state, time, arrivalCursor);
+   if (snapshot->state.failed || snapshots->log.failed)
+   {
+      fprintf(stderr, "Out of memory for snapshots, so the run goes on without them\n");
+      free(snapshot->state.data);
+      snapshots->interval = 0;
+      return;
+   }
+
+   snapshots->count++;
+   snapshots->nextTime = (s->runtime - time > snapshots->interval) ?
+                         (time - time % snapshots->interval + snapshots->interval) : s->runtime;
+}
+
+void destroySnapshots(scheduler* s)
+{
+   int i;
+   for (i = 0; i < s->snapshots.count; i++)
+   {
+      free(s->snapshots.list[i].state.data);
+   }
+   free(s->snapshots.list);
+   free(s->snapshots.log.data);
+   memset(&s->snapshots, 0, sizeof(snapshotState));
+}
+
+// Change the arrival and burst of a process, and move it to its place in
+// the arrival order. Only the processes that arrive between its old and
+// new arrival move.
+void moveProcess(scheduler* s, int idx, long long arrival, long long burst)
+{
+   long long* times = s->arrivalTimes;
+   int* order = s->arrivalOrder;
+   long long oldArrival = s->processes.arrival[idx];
+
+   // Arrivals are in order of time, then of input.
+   int pos = 0;
+   int high = s->processCount;
+   while (pos < high)
+   {
+      int mid = pos + (high - pos) / 2;
+      if ((times[mid] < oldArrival) || ((times[mid] == oldArrival) && (order[mid] < idx)))
+      {
+         pos = mid + 1;
+      }
+      else
+      {
+         high = mid;
+      }
+   }
+
+   while ((pos > 0) && ((times[pos - 1] > arrival) || ((times[pos - 1] == arrival) && (order[pos - 1] > idx))))
+   {
+      times[pos] = times[pos - 1];
+      order[pos] = order[pos - 1];
+      pos--;
+   }
+   while ((pos + 1 < s->processCount) &&
+          ((times[pos + 1] < arrival) || ((times[pos + 1] == arrival) && (order[pos + 1] < idx))))
+   {
+      times[pos] = times[pos + 1];
+      order[pos] = order[pos + 1];
+      pos++;
+   }
+
+   times[pos] = arrival;
+   order[pos] = idx;
+   s->processes.arrival[idx] = arrival;
+   s->processes.burst[idx] = burst;
+}
+
+// The stats of a process as printProcessStats() prints them, after its name.
+void printOutcome(FILE* f, process* p, long long endTime)
+{
+   if (endTime <= 0)
+   {
+      fputs(" didn't finish", f);
+      return;
+   }
+
+   long long cpuTime = p->burst;
+   long long ioTime = 0;
+   addCycleTimes(p, &cpuTime, &ioTime);
+
+   fprintf(f, " wait %lld", endTime - p->arrival - cpuTime - ioTime);
+   if (p->cycleCount > 0)
+   {
+      fprintf(f, " io %lld", ioTime);
+   }
+   fprintf(f, " turnaround %lld", endTime - p->arrival);
+}
+
+void printWhatIfSummary(FILE* f, const char* label, schedulerSummary* summary)
+{
+   fprintf(f, "%s: %d of %d processes finished", label, summary->finishedCount, summary->processCount);
+   if (summary->finishedCount > 0)
+   {
+      fprintf(f, ", average wait %.2f", averageOf(summary->totalWait, summary->finishedCount));
+      if (summary->totalIoWait > 0)
+      {
+         fprintf(f, ", average io %.2f", averageOf(summary->totalIoWait, summary->finishedCount));
+      }
+      fprintf(f, ", average turnaround %.2f", averageOf(summary->totalTurnaround, summary->finishedCount));
+   }
+   fprintf(f, ", %lld context switches\n", summary->contextSwitches);
+}
+
+/** Quantum sweep **/
+// Work shared by the threads of a sweep. Each thread takes the next quantum
+// until there are none left.
+typedef struct
+{
+   scheduler* runs;
+   int runCount;
+   int nextRun;
+   pthread_mutex_t lock;
+} sweepQueue;
+
+// Run round robin once for each quantum of the sweep. Every run is a silent
+// copy of the scheduler with its own run state and cores, sharing the
+// parsed process table, so the runs can go in parallel.
+void runSweep(scheduler* s)
+{
+   sweepQueue queue;
+   queue.runCount = s->sweepLast - s->quantum + 1;
+   queue.nextRun = 0;
+   queue.runs = calloc(queue.runCount, sizeof(scheduler));
+   pthread_mutex_init(&queue.lock, NULL);
+
+   int i;
+   for (i = 0; i < queue.runCount; i++)
+   {
+      scheduler* run = &queue.runs[i];
+      *run = *s;
+      run->quantum = s->quantum + i;
+      run->sweepLast = 0;
+      run->silent = TRUE;
+      run->summaryOnly = FALSE;
+      run->metricsFile = NULL;
+      memset(&run->output, 0, sizeof(outputWriter));
+      run->output.fd = -1;
+   }
+
+   int threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+   if (threadCount > queue.runCount)
+   {
+      threadCount = queue.runCount;
+   }
+   if (threadCount < 1)
+   {
+      threadCount = 1;
+   }
+
+   pthread_t* threads = calloc(threadCount, sizeof(pthread_t));
+   int started = 0;
+   for (i = 0; i < threadCount; i++)
+   {
+      if (0 == pthread_create(&threads[started], NULL, runSweepWorker, &queue))
+      {
+         started++;
+      }
+   }
+
+   // Without any thread, run the sweep on this one.
+   if (0 == started)
+   {
+      runSweepWorker(&queue);
+   }
+
+   for (i = 0; i < started; i++)
+   {
+      pthread_join(threads[i], NULL);
+   }
+
+   pthread_mutex_destroy(&queue.lock);
+   free(threads);
+
+   printSweepTable(s, queue.runs, queue.runCount);
+   free(queue.runs);
+}
+
+void* runSweepWorker(void* arg)
+{
+   sweepQueue* queue = arg;
+
+   while (1)
+   {
+      pthread_mutex_lock(&queue->lock);
+      int next = queue->nextRun++;
+      pthread_mutex_unlock(&queue->lock);
+
+      if (next >= queue->runCount)
+      {
+         break;
+      }
+
+      scheduler* run = &queue->runs[next];
+      createRunState(run);
+      runRoundRobin(run);
+      destroyRunState(run);
+   }
+
+   return NULL;
+}
+
+// Print one row per quantum. Averages are over the processes that finished.
+void printSweepTable(scheduler* s, scheduler* runs, int runCount)
+{
+   char row[128];
+
+   writeString(s, "Quantum  Finished  Average wait  Average turnaround  Context switches\n");
+
+   int i;
+   for (i = 0; i < runCount; i++)
+   {
+      schedulerSummary* summary = &runs[i].summary;
+      int finished = summary->finishedCount;
+
+      snprintf(row, sizeof(row), "%7lld  %8d  %12.2f  %18.2f  %16lld\n",
+               runs[i].quantum, finished,
+               (finished > 0) ? (double) summary->totalWait / finished : 0.0,
+               (finished > 0) ? (double) summary->totalTurnaround / finished : 0.0,
+               summary->contextSwitches);
+      writeString(s, row);
+   }
+}
+
+// The capacity is rounded up to a power of two, of at least 16.
+void createQueue(integerQueue *q, int capacity)
+{
+   unsigned int size = 16;
+   while (size < (unsigned int) capacity)
+   {
+      size *= 2;
+   }
+
+   q->array = malloc(size * sizeof(int));
+   q->head = q->tail = 0;
+   q->mask = size - 1;
+}
+
+void destroyQueue(integerQueue *q)
+{
+   free(q->array);
+   q->array = NULL;
+   q->head = q->tail = 0;
+   q->mask = 0;
+}
+
+int queueCount(integerQueue *q)
+{
+   return (int) (q->tail - q->head);
+}
+
+BOOL isEmpty(integerQueue *q)
+{
+   return (q->head == q->tail);
+}
+
+BOOL isFull(integerQueue *q)
+{
+   return (q->tail - q->head == q->mask + 1);
+}
+
+// Double the capacity of the queue until it holds at least the given number
+// of processes, keeping their order. The processes are moved to the start.
+BOOL growQueue(integerQueue *q, unsigned int capacity)
+{
+   unsigned int count = q->tail - q->head;
+   unsigned int size = q->mask + 1;
+   while (size < capacity)
+   {
+      size *= 2;
+   }
+
+   int *array = malloc(size * sizeof(int));
+   if (NULL == array)
+   {
+      return FALSE;
+   }
+
+   // The processes are in at most two pieces: up to the end of the array,
+   // and from its start.
+   unsigned int start = q->head & q->mask;
+   unsigned int first = (count < q->mask + 1 - start) ? count : (q->mask + 1 - start);
+   memcpy(array, &q->array[start], first * sizeof(int));
+   memcpy(&array[first], q->array, (count - first) * sizeof(int));
+
+   free(q->array);
+   q->array = array;
+   q->head = 0;
+   q->tail = count;
+   q->mask = size - 1;
+
+   return TRUE;
+}
+
+// The queue grows when it is full, since a stream doesn't say up front how
+// many processes can be ready at once. Fails only if memory runs out.
+BOOL enqueue(integerQueue *q, int val)
+{
+   if (isFull(q) && !growQueue(q, 2 * (q->mask + 1)))
+   {
+      return FALSE;
+   }
+
+   q->array[q->tail++ & q->mask] = val;
+
+   return TRUE;
+}
+
+// Add several processes in order, growing the queue at most once.
+BOOL enqueueAll(integerQueue *q, const int *vals, int count)
+{
+   unsigned int needed = (q->tail - q->head) + count;
+   if ((needed > q->mask + 1) && !growQueue(q, needed))
+   {
+      return FALSE;
+   }
+
+   unsigned int start = q->tail & q->mask;
+   unsigned int first = ((unsigned int) count < q->mask + 1 - start) ? (unsigned int) count : (q->mask + 1 - start);
+   memcpy(&q->array[start], vals, first * sizeof(int));
+   memcpy(q->array, &vals[first], (count - first) * sizeof(int));
+   q->tail += count;
+
+   return TRUE;
+}
+
+int dequeue(integerQueue *q)
+{
+   if (isEmpty(q))
+   {
+      return -1;
+   }
+
+   return q->array[q->head++ & q->mask];
+}
+
+// Determine if entry A should be selected over entry B.
+// Ties on the remaining burst go to the process listed first in the input.
+BOOL isShorterJob(heapEntry *a, heapEntry *b)
+{
+   return (a->burst < b->burst) || ((a->burst == b->burst) && (a->order < b->order));
+}
+
+void createHeap(burstHeap *h, int capacity)
+{
+   h->array = calloc(capacity, sizeof(heapEntry));
+   h->size = 0;
+   h->capacity = capacity;
+}
+
+void destroyHeap(burstHeap *h)
+{
+   free(h->array);
+   h->size = 0;
+   h->capacity = 0;
+}
+
+BOOL isHeapEmpty(burstHeap *h)
+{
+   return (0 == h->size);
+}
+
+void heapPush(burstHeap *h, int idx, long long burst, int order)
+{
+   // Make room for the process if the heap is full.
+   if (h->size == h->capacity)
+   {
+      h->capacity = (h->capacity > 0) ? (2 * h->capacity) : 16;
+      h->array = realloc(h->array, h->capacity * sizeof(heapEntry));
+   }
+
+   heapEntry entry = { burst, order, idx };
+
+   // Sift the new process up until its parent is shorter.
+   int pos = h->size++;
+   while (pos > 0)
+   {
+      int parent = (pos - 1) / 2;
+      if (!isShorterJob(&entry, &h->array[parent]))
+      {
+         break;
+      }
+      h->array[pos] = h->array[parent];
+      pos = parent;
+   }
+   h->array[pos] = entry;
+}
+
+heapEntry *heapPeek(burstHeap *h)
+{
+   return isHeapEmpty(h) ? NULL : &h->array[0];
+}
+
+int heapPop(burstHeap *h)
+{
+   if (isHeapEmpty(h))
+   {
+      return -1;
+   }
+
+   int top = h->array[0].idx;
+   heapEntry last = h->array[--h->size];
+
+   // Sift the last process down from the root until both children are longer.
+   int pos = 0;
+   while (TRUE)
+   {
+      int child = 2 * pos + 1;
+      if (child >= h->size)
+      {
+         break;
+      }
+      if ((child + 1 < h->size) && isShorterJob(&h->array[child + 1], &h->array[child]))
+      {
+         child++;
+      }
+      if (!isShorterJob(&h->array[child], &last))
+      {
+         break;
+      }
+      h->array[pos] = h->array[child];
+      pos = child;
+   }
+   h->array[pos] = last;
+
+   return top;
+}
+
+/** Red-black tree **/
+// Determine if process A comes before process B in a tree of ready processes.
+// Ties on the virtual runtime go to the process listed first in the input.
+BOOL isBeforeInTree(scheduler* s, int a, int b)
+{
+   long long* vruntime = s->state.vruntime;
+   return (vruntime[a] < vruntime[b]) ||
+          ((vruntime[a] == vruntime[b]) && (s->processes.order[a] < s->processes.order[b]));
+}
+
+void treeInsert(scheduler* s, readyTree* t, int idx)
+{
+   treeLink* links = s->state.links;
+   int parent = -1;
+   int cur = t->root;
+   BOOL leftmost = TRUE;
+
+   while (-1 != cur)
+   {
+      parent = cur;
+      if (isBeforeInTree(s, idx, cur))
+      {
+         cur = links[cur].left;
+      }
+      else
+      {
+         cur = links[cur].right;
+         leftmost = FALSE;
+      }
+   }
+
+   links[idx].left = -1;
+   links[idx].right = -1;
+   links[idx].parent = parent;
+   links[idx].red = TRUE;
+   if (-1 == parent)
+   {
+      t->root = idx;
+   }
+   else if (isBeforeInTree(s, idx, parent))
+   {
+      links[parent].left = idx;
+   }
+   else
+   {
+      links[parent].right = idx;
+   }
+   if (leftmost)
+   {
+      t->leftmost = idx;
+   }
+   t->size++;
+
+   // Repaint or rotate until no red process has a red parent.
+   int z = idx;
+   while ((z != t->root) && links[links[z].parent].red)
+   {
+      int p = links[z].parent;
+      int g = links[p].parent;
+      if (p == links[g].left)
+      {
+         int uncle = links[g].right;
+         if ((-1 != uncle) && links[uncle].red)
+         {
+            links[p].red = FALSE;
+            links[uncle].red = FALSE;
+            links[g].red = TRUE;
+            z = g;
+         }
+         else
+         {
+            if (z == links[p].right)
+            {
+               z = p;
+               rotateLeft(s, t, z);
+               p = links[z].parent;
+            }
+            links[p].red = FALSE;
+            links[g].red = TRUE;
+            rotateRight(s, t, g);
+         }
+      }
+      else
+      {
+         int uncle = links[g].left;
+         if ((-1 != uncle) && links[uncle].red)
+         {
+            links[p].red = FALSE;
+            links[uncle].red = FALSE;
+            links[g].red = TRUE;
+            z = g;
+         }
+         else
+         {
+            if (z == links[p].left)
+            {
+               z = p;
+               rotateRight(s, t, z);
+               p = links[z].parent;
+            }
+            links[p].red = FALSE;
+            links[g].red = TRUE;
+            rotateLeft(s, t, g);
+         }
+      }
+   }
+   links[t->root].red = FALSE;
+}
+
+// Take the leftmost process out of the tree, or return -1 if it is empty.
+// The leftmost process has no left child, so only its right child takes
+// its place.
+int treePopMin(scheduler* s, readyTree* t)
+{
+   treeLink* links = s->state.links;
+   int z = t->leftmost;
+   if (-1 == z)
+   {
+      return -1;
+   }
+
+   int x = links[z].right;
+   int parent = links[z].parent;
+   if (-1 == parent)
+   {
+      t->root = x;
+   }
+   else
+   {
+      links[parent].left = x;
+   }
+   if (-1 != x)
+   {
+      links[x].parent = parent;
+   }
+
+   // The next process in order is the leftmost of the right subtree, or
+   // else the parent. Rotations don't change the order.
+   t->leftmost = parent;
+   if (-1 != x)
+   {
+      t->leftmost = x;
+      while (-1 != links[t->leftmost].left)
+      {
+         t->leftmost = links[t->leftmost].left;
+      }
+   }
+   t->size--;
+
+   if (links[z].red)
+   {
+      return z;
+   }
+
+   // A black process was removed, so the path through x is short of one
+   // black process until it is repainted or rotated into balance.
+   while ((x != t->root) && ((-1 == x) || !links[x].red))
+   {
+      if (x == links[parent].left)
+      {
+         int w = links[parent].right;
+         if (links[w].red)
+         {
+            links[w].red = FALSE;
+            links[parent].red = TRUE;
+            rotateLeft(s, t, parent);
+            w = links[parent].right;
+         }
+         if (((-1 == links[w].left) || !links[links[w].left].red) &&
+             ((-1 == links[w].right) || !links[links[w].right].red))
+         {
+            links[w].red = TRUE;
+            x = parent;
+            parent = links[x].parent;
+         }
+         else
+         {
+            if ((-1 == links[w].right) || !links[links[w].right].red)
+            {
+               links[links[w].left].red = FALSE;
+               links[w].red = TRUE;
+               rotateRight(s, t, w);
+               w = links[parent].right;
+            }
+            links[w].red = links[parent].red;
+            links[parent].red = FALSE;
+            links[links[w].right].red = FALSE;
+            rotateLeft(s, t, parent);
+            x = t->root;
+         }
+      }
+      else
+      {
+         int w = links[parent].left;
+         if (links[w].red)
+         {
+            links[w].red = FALSE;
+            links[parent].red = TRUE;
+            rotateRight(s, t, parent);
+            w = links[parent].left;
+         }
+         if (((-1 == links[w].left) || !links[links[w].left].red) &&
+             ((-1 == links[w].right) || !links[links[w].right].red))
+         {
+            links[w].red = TRUE;
+            x = parent;
+            parent = links[x].parent;
+         }
+         else
+         {
+            if ((-1 == links[w].left) || !links[links[w].left].red)
+            {
+               links[links[w].right].red = FALSE;
+               links[w].red = TRUE;
+               rotateLeft(s, t, w);
+               w = links[parent].left;
+            }
+            links[w].red = links[parent].red;
+            links[parent].red = FALSE;
+            links[links[w].left].red = FALSE;
+            rotateRight(s, t, parent);
+            x = t->root;
+         }
+      }
+   }
+   if (-1 != x)
+   {
+      links[x].red = FALSE;
+   }
+
+   return z;
+}
+
+void rotateLeft(scheduler* s, readyTree* t, int x)
+{
+   treeLink* links = s->state.links;
+   int y = links[x].right;
+
+   links[x].right = links[y].left;
+   if (-1 != links[y].left)
+   {
+      links[links[y].left].parent = x;
+   }
+   links[y].parent = links[x].parent;
+   if (-1 == links[x].parent)
+   {
+      t->root = y;
+   }
+   else if (x == links[links[x].parent].left)
+   {
+      links[links[x].parent].left = y;
+   }
+   else
+   {
+      links[links[x].parent].right = y;
+   }
+   links[y].left = x;
+   links[x].parent = y;
+}
+
+void rotateRight(scheduler* s, readyTree* t, int x)
+{
+   treeLink* links = s->state.links;
+   int y = links[x].left;
+
+   links[x].left = links[y].right;
+   if (-1 != links[y].right)
+   {
+      links[links[y].right].parent = x;
+   }
+   links[y].parent = links[x].parent;
+   if (-1 == links[x].parent)
+   {
+      t->root = y;
+   }
+   else if (x == links[links[x].parent].right)
+   {
+      links[links[x].parent].right = y;
+   }
+   else
+   {
+      links[links[x].parent].left = y;
+   }
+   links[y].right = x;
+   links[x].parent = y;
+}
+
+// The process after the given one in the order of the tree, or -1.
+int treeNext(scheduler* s, int idx)
+{
+   treeLink* links = s->state.links;
+   if (-1 != links[idx].right)
+   {
+      idx = links[idx].right;
+      while (-1 != links[idx].left)
+      {
+         idx = links[idx].left;
+      }
+      return idx;
+   }
+
+   while ((-1 != links[idx].parent) && (links[links[idx].parent].right == idx))
+   {
+      idx = links[idx].parent;
+   }
+   return links[idx].parent;
+}
+
+/** Timing wheel **/
+void createWheel(timerWheel* w, int capacity)
+{
+   memset(w, 0, sizeof(timerWheel));
+   w->capacity = capacity;
+   w->when = calloc(capacity, sizeof(long long));
+   w->next = calloc(capacity, sizeof(int));
+   w->prev = calloc(capacity, sizeof(int));
+   w->slot = calloc(capacity, sizeof(int));
+
+   int i;
+   for (i = 0; i < capacity; i++)
+   {
+      w->slot[i] = -1;
+   }
+   for (i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; i++)
+   {
+      w->first[i] = -1;
+      w->last[i] = -1;
+   }
+}
+
+void destroyWheel(timerWheel* w)
+{
+   free(w->when);
+   free(w->next);
+   free(w->prev);
+   free(w->slot);
+   memset(w, 0, sizeof(timerWheel));
+}
+
+// Add a timer to the end of the slot for its time. Timers only cascade into
+// levels that are empty, so each slot stays in the order of scheduling.
+void wheelLink(timerWheel* w, int id)
+{
+   unsigned long long differing = (unsigned long long) (w->when[id] ^ w->now);
+   int level = (0 == differing) ? 0 : ((63 - __builtin_clzll(differing)) / WHEEL_BITS);
+   int slot = level * WHEEL_SLOTS + ((w->when[id] >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1));
+
+   w->next[id] = -1;
+   w->prev[id] = w->last[slot];
+   if (-1 == w->last[slot])
+   {
+      w->first[slot] = id;
+   }
+   else
+   {
+      w->next[w->last[slot]] = id;
+   }
+   w->last[slot] = id;
+   w->slot[id] = slot;
+   w->occupied[level] |= 1ULL << (slot % WHEEL_SLOTS);
+}
+
+void wheelUnlink(timerWheel* w, int id)
+{
+   int slot = w->slot[id];
+   if (-1 == w->prev[id])
+   {
+      w->first[slot] = w->next[id];
+   }
+   else
+   {
+      w->next[w->prev[id]] = w->next[id];
+   }
+   if (-1 == w->next[id])
+   {
+      w->last[slot] = w->prev[id];
+   }
+   else
+   {
+      w->prev[w->next[id]] = w->prev[id];
+   }
+
+   if (-1 == w->first[slot])
+   {
+      w->occupied[slot / WHEEL_SLOTS] &= ~(1ULL << (slot % WHEEL_SLOTS));
+   }
+   w->slot[id] = -1;
+}
+
+// Schedule a timer, or move it if it is pending. A timer that is already
+// pending at the same time keeps its place among the timers of that time.
+// The time can't be before the time the wheel has reached.
+void wheelSchedule(timerWheel* w, int id, long long when)
+{
+   if (-1 != w->slot[id])
+   {
+      if (w->when[id] == when)
+      {
+         return;
+      }
+      wheelUnlink(w, id);
+   }
+
+   w->when[id] = when;
+   wheelLink(w, id);
+}
+
+void wheelCancel(timerWheel* w, int id)
+{
+   if (-1 != w->slot[id])
+   {
+      wheelUnlink(w, id);
+   }
+}
+
+// Make room for timers up to the given id, doubling the capacity.
+BOOL growWheel(timerWheel* w, int capacity)
+{
+   int size = (w->capacity > 0) ? w->capacity : 16;
+   while (size < capacity)
+   {
+      size *= 2;
+   }
+
+   long long* when = realloc(w->when, size * sizeof(long long));
+   int* next = realloc(w->next, size * sizeof(int));
+   int* prev = realloc(w->prev, size * sizeof(int));
+   int* slot = realloc(w->slot, size * sizeof(int));
+   w->when = (NULL != when) ? when : w->when;
+   w->next = (NULL != next) ? next : w->next;
+   w->prev = (NULL != prev) ? prev : w->prev;
+   w->slot = (NULL != slot) ? slot : w->slot;
+   if ((NULL == when) || (NULL == next) || (NULL == prev) || (NULL == slot))
+   {
+      return FALSE;
+   }
+
+   int i;
+   for (i = w->capacity; i < size; i++)
+   {
+      w->slot[i] = -1;
+   }
+   w->capacity = size;
+   return TRUE;
+}
+
+// Find the time of the earliest pending timer like wheelNextBefore(), but
+// without moving the wheel, by looking through the first slot in use.
+long long wheelPeek(timerWheel* w, long long limit)
+{
+   int level = 0;
+   while ((level < WHEEL_LEVELS) && (0 == w->occupied[level]))
+   {
+      level++;
+   }
+   if (WHEEL_LEVELS == level)
+   {
+      return limit;
+   }
+
+   long long earliest = limit;
+   int id;
+   for (id = w->first[level * WHEEL_SLOTS + __builtin_ctzll(w->occupied[level])]; -1 != id; id = w->next[id])
+   {
+      if (w->when[id] < earliest)
+      {
+         earliest = w->when[id];
+      }
+   }
+
+   return earliest;
+}
+
+// Find the time of the earliest pending timer, or the limit if no timer is
+// due before it. The first slot of the lowest level in use holds the
+// earliest timers. A slot of a higher level cascades down on the way, which
+// moves the wheel up to the start of the slot, at most to the time returned.
+long long wheelNextBefore(timerWheel* w, long long limit)
+{
+   while (TRUE)
+   {
+      int level = 0;
+      while ((level < WHEEL_LEVELS) && (0 == w->occupied[level]))
+      {
+         level++;
+      }
+      if (WHEEL_LEVELS == level)
+      {
+         return limit;
+      }
+
+      int shift = level * WHEEL_BITS;
+      long long slot = __builtin_ctzll(w->occupied[level]);
+      long long above = (shift + WHEEL_BITS >= 64) ? 0 : ((w->now >> (shift + WHEEL_BITS)) << (shift + WHEEL_BITS));
+      long long start = above | (slot << shift);
+      if (start >= limit)
+      {
+         return limit;
+      }
+      if (0 == level)
+      {
+         return start;
+      }
+
+      int cascading = w->first[level * WHEEL_SLOTS + slot];
+      w->first[level * WHEEL_SLOTS + slot] = -1;
+      w->last[level * WHEEL_SLOTS + slot] = -1;
+      w->occupied[level] &= ~(1ULL << slot);
+      w->now = start;
+      while (-1 != cascading)
+      {
+         int next = w->next[cascading];
+         wheelLink(w, cascading);
+         cascading = next;
+      }
+   }
+}
+
+// Take the next timer due by the given time, in order of time and then of
+// scheduling, or return -1 if there is none.
+int wheelPop(timerWheel* w, long long time)
+{
+   long long next = wheelNextBefore(w, time + 1);
+   if (next > time)
+   {
+      return -1;
+   }
+
+   int id = w->first[next % WHEEL_SLOTS];
+   wheelUnlink(w, id);
+   return id;
+}
@@ -0,0 +1,114 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+
+// A simulation of a CPU scheduler. Each scheduler holds all of its own
+// state, so any number of them can be run at once on separate threads.
+//
+// Typical use:
+//    scheduler* s = createScheduler();
+//    setSchedulerOutputFile(s, "processes.out");
+//    loadScheduler(s, "processes.in");
+//    runScheduler(s);
+//    destroyScheduler(s);
+//
+// Functions that return an int return 0 on success and -1 on failure,
+// after printing the reason to stderr.
+typedef struct scheduler scheduler;
+
+// Aggregate results of a run.
+typedef struct
+{
+   long long endTime;
+   int processCount;
+   int finishedCount;
+   // Wait is the time processes spent ready. The time they spent in I/O
+   // is counted apart.
+   long long totalWait;
+   long long totalIoWait;
+   long long totalTurnaround;
+   // Number of times a core started running a different process.
+   long long contextSwitches;
+   // Number of instants the simulation stopped at to update its state.
+   long long events;
+} schedulerSummary;
+
+// Formats of the metrics file.
+typedef enum
+{
+   MetricsJson,
+   MetricsCsv
+} schedulerMetricsFormat;
+
+scheduler* createScheduler();
+void destroyScheduler(scheduler* s);
+
+// Send the trace to a file, or to a file descriptor that stays open after
+// the scheduler is destroyed.
+int setSchedulerOutputFile(scheduler* s, const char* fileName);
+int setSchedulerOutputFd(scheduler* s, int fd);
+
+// Also write machine-readable metrics of the run to a file: context
+// switches, utilization, ready queue depth, wait and turnaround percentiles,
+// throughput, wall-clock time and events. Sweeps don't write metrics.
+int setSchedulerMetricsFile(scheduler* s, const char* fileName, schedulerMetricsFormat format);
+
+// Skip the trace of every event and only write when the simulation
+// finished, with the stats of all processes together and of each CPU.
+void setSchedulerSummaryOnly(scheduler* s, int summaryOnly);
+
+// Write the compact binary trace described in trace.h instead of text.
+// The decode tool turns it back into the text trace.
+void setSchedulerBinaryTrace(scheduler* s, int binaryTrace);
+
+// Save the run to a checkpoint file every few seconds, and the processes
+// that finished to a log next to it named after it with ".finished", so
+// that a run that is stopped can go on where it was. With resume, go on from
+// the checkpoint in the file instead of starting over, if there is one. The
+// output file then keeps what the checkpoint covers and the rest is written
+// again, so set this before the output file. The output must be a file, and
+// the input and settings the same as when the checkpoint was written. Only
+// a single run of an input file can be checkpointed, and the checkpoint is
+// removed once the run has finished.
+int setSchedulerCheckpoint(scheduler* s, const char* fileName, int resume);
+
+// Keep about count snapshots of the run in memory, evenly spread over its
+// runtime, so that what-if runs can start from them. Only a single run of
+// an input file that isn't resumed from a checkpoint can have snapshots.
+void setSchedulerSnapshots(scheduler* s, int count);
+
+// Load the processes to schedule from an input file.
+int loadScheduler(scheduler* s, const char* fileName);
+
+// Load the processes from input text in memory. The names of the processes
+// point into the text, so it must outlive the scheduler.
+int loadSchedulerData(scheduler* s, const char* data, size_t size);
+
+// Read the processes from a file descriptor while the simulation runs.
+// Only the settings before the first process are read here.
+int loadSchedulerStream(scheduler* s, int fd);
+
+// Simulate the loaded processes and write the trace and stats. With a
+// round robin quantum range like "quantum 1..64", simulate every quantum of
+// the range in parallel and write a table of their results instead.
+int runScheduler(scheduler* s);
+
+// Get the aggregate results once the scheduler has run.
+int getSchedulerSummary(scheduler* s, schedulerSummary* summary);
+
+// Get the position in the input of the process with the given name, or -1.
+int findSchedulerProcess(scheduler* s, const char* name);
+
+// Once a run with snapshots has finished, simulate it again as if a process
+// arrived at another time or had another burst. A negative arrival or burst
+// keeps the one of the input. Only the part of the run from the last
+// snapshot before the process arrives, either way, is simulated again. The
+// stats of both runs and of each process that finished at another time are
+// written to fd, and the aggregate results of the new run to summary, if it
+// isn't NULL. The scheduler is left as the first run left it, so any number
+// of what-if runs can follow.
+int whatIfScheduler(scheduler* s, int process, long long arrival, long long burst, int fd,
+                    schedulerSummary* summary);
+
+#endif
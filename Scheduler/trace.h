@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Binary trace, written by the scheduler instead of the text trace and
+// turned back into the exact text by the decode tool.
+//
+// Numbers are LEB128 varints. Signed numbers are zigzag encoded first.
+//
+// Header:
+//    TRACE_MAGIC, a TRACE_VERSION byte and the CPU count.
+//    The configuration text that starts the text trace, ended by a 0 byte.
+//    The number of names, then the length and bytes of each name.
+//
+// Processes are identified by their position in the input, which indexes
+// the name table. A stream doesn't know its processes up front, so it has
+// no name table and gives each name in a TraceName record instead, before
+// the process is first used.
+//
+// Records:
+//    A type byte. Timed records then hold the time since the previous timed
+//    record, which starts at 0. Then come the fields of the type. CPU ids
+//    marked [cpu] are only there with more than one CPU.
+//    The last record is always TraceEnd, so a trace that was cut short
+//    can be told from a whole one.
+#define TRACE_MAGIC "SCTR"
+#define TRACE_MAGIC_LENGTH 4
+#define TRACE_VERSION 2
+
+typedef enum
+{
+   // Timed: process.
+   TraceArrived,
+   // Timed: process, signed remaining burst, [cpu].
+   TraceSelected,
+   // Timed: process, [cpu].
+   TraceFinished,
+   // Timed: process, thief cpu, victim cpu.
+   TraceStolen,
+   // Timed: number of idle ticks, then [number of idle CPUs, each cpu].
+   // Every tick lists the same idle CPUs.
+   TraceIdle,
+   // Timed.
+   TraceSchedulerFinished,
+   // Process, signed wait, signed turnaround.
+   TraceStats,
+   // Process.
+   TraceUnfinished,
+   // Cpu, busy time. The idle time and utilization follow from the time
+   // of TraceSchedulerFinished.
+   TraceCpuStats,
+   // Finished count, process count, signed total wait, signed total turnaround.
+   TraceAggregate,
+   // Process, name length, name bytes.
+   TraceName,
+   // Timed: process, I/O wait, [cpu].
+   TraceStartedIo,
+   // Timed: process.
+   TraceFinishedIo,
+   // Stats of a process with I/O. Process, signed wait, I/O wait,
+   // signed turnaround.
+   TraceIoStats,
+   // Aggregate stats of processes with I/O. Finished count, process count,
+   // signed total wait, total I/O wait, signed total turnaround.
+   TraceIoAggregate,
+   // End of the trace, with no fields.
+   TraceEnd
+} traceRecordType;
+
+#endif
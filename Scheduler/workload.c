@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "workload.h"
+
+// Growing text buffer that the workload is written into.
+typedef struct
+{
+   char* data;
+   size_t length;
+   size_t capacity;
+} textBuffer;
+
+// Random number generator state. Each pass over the workload starts from
+// the seed, so both passes see the same processes.
+typedef struct
+{
+   unsigned long long state;
+} randomSource;
+
+/** Prototypes **/
+void seedRandom(randomSource* r, unsigned long long seed);
+double nextUniform(randomSource* r);
+long long nextArrivalGap(const workloadOptions* o, randomSource* r, int idx, double* clock);
+long long nextBurst(const workloadOptions* o, randomSource* r);
+double effectiveRate(const workloadOptions* o);
+long long estimateRuntime(const workloadOptions* o);
+void appendText(textBuffer* b, const char* text);
+void appendInt(textBuffer* b, long long val);
+
+void setDefaultWorkload(workloadOptions* o)
+{
+   memset(o, 0, sizeof(workloadOptions));
+   o->processCount = 1000;
+   o->algorithm = "fcfs";
+   o->quantum = 4;
+   o->cpuCount = 1;
+   o->arrivals = ArrivalsPoisson;
+   o->phaseLength = 100;
+   o->burstiness = 4.0;
+   o->bursts = BurstsExponential;
+   o->meanBurst = 10.0;
+   o->paretoShape = 1.5;
+   o->seed = 1;
+}
+
+int setWorkloadOption(workloadOptions* o, const char* name, const char* value)
+{
+   if (0 == strcmp(name, "--count"))
+   {
+      o->processCount = atoi(value);
+      return (o->processCount >= 0) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--use"))
+   {
+      o->algorithm = value;
+      return ((0 == strcmp(value, "fcfs")) || (0 == strcmp(value, "sjf")) ||
+              (0 == strcmp(value, "rr")) || (0 == strcmp(value, "mlfq")) ||
+              (0 == strcmp(value, "cfs"))) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--quantum"))
+   {
+      o->quantum = atoll(value);
+      return (o->quantum > 0) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--cpus"))
+   {
+      o->cpuCount = atoi(value);
+      return (o->cpuCount > 0) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--arrivals"))
+   {
+      if (0 == strcmp(value, "poisson"))
+      {
+         o->arrivals = ArrivalsPoisson;
+         return 0;
+      }
+      if (0 == strcmp(value, "bursty"))
+      {
+         o->arrivals = ArrivalsBursty;
+         return 0;
+      }
+      return -1;
+   }
+   if (0 == strcmp(name, "--rate"))
+   {
+      o->arrivalRate = atof(value);
+      return (o->arrivalRate >= 0) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--phase"))
+   {
+      o->phaseLength = atoi(value);
+      return (o->phaseLength > 0) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--burstiness"))
+   {
+      o->burstiness = atof(value);
+      return (o->burstiness >= 1) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--bursts"))
+   {
+      if (0 == strcmp(value, "exponential"))
+      {
+         o->bursts = BurstsExponential;
+         return 0;
+      }
+      if (0 == strcmp(value, "pareto"))
+      {
+         o->bursts = BurstsPareto;
+         return 0;
+      }
+      return -1;
+   }
+   if (0 == strcmp(name, "--mean-burst"))
+   {
+      o->meanBurst = atof(value);
+      return (o->meanBurst >= 1) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--shape"))
+   {
+      o->paretoShape = atof(value);
+      return (o->paretoShape > 1) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--runfor"))
+   {
+      o->runtime = atoll(value);
+      return (o->runtime >= 0) ? 0 : -1;
+   }
+   if (0 == strcmp(name, "--seed"))
+   {
+      o->seed = strtoull(value, NULL, 10);
+      return 0;
+   }
+
+   return -1;
+}
+
+void printWorkloadUsage(FILE* file)
+{
+   fprintf(file,
+           "  --count N               number of processes (1000)\n"
+           "  --use fcfs|sjf|rr|mlfq|cfs\n"
+           "                          scheduling algorithm (fcfs)\n"
+           "  --quantum Q             quantum of RR and CFS, and of the top MLFQ level (4)\n"
+           "  --cpus N                number of CPUs (1)\n"
+           "  --arrivals poisson|bursty\n"
+           "                          arrival pattern (poisson)\n"
+           "  --rate R                mean arrivals per time unit (about 90%% load)\n"
+           "  --phase N               processes per bursty phase (100)\n"
+           "  --burstiness F          rate factor of bursty phases (4)\n"
+           "  --bursts exponential|pareto\n"
+           "                          burst distribution (exponential)\n"
+           "  --mean-burst M          mean burst time (10)\n"
+           "  --shape A               Pareto shape, above 1 (1.5)\n"
+           "  --runfor T              time to run for (until FCFS would finish)\n"
+           "  --seed S                random seed (1)\n");
+}
+
+// Generate the workload in two passes over the same random sequence: the
+// first finds how long to run for, the second writes the processes.
+char* generateWorkload(const workloadOptions* o, size_t* size)
+{
+   textBuffer b = { NULL, 0, 0 };
+   long long runtime = (o->runtime > 0) ? o->runtime : estimateRuntime(o);
+
+   appendText(&b, "processcount ");
+   appendInt(&b, o->processCount);
+   appendText(&b, "\nrunfor ");
+   appendInt(&b, runtime);
+   appendText(&b, "\nuse ");
+   appendText(&b, o->algorithm);
+   appendText(&b, "\nquantum ");
+   appendInt(&b, o->quantum);
+   if (o->cpuCount > 1)
+   {
+      appendText(&b, "\ncpus ");
+      appendInt(&b, o->cpuCount);
+   }
+   appendText(&b, "\n");
+
+   randomSource r;
+   seedRandom(&r, o->seed);
+   double clock = 0;
+
+   int i;
+   for (i = 0; i < o->processCount; i++)
+   {
+      long long arrival = nextArrivalGap(o, &r, i, &clock);
+      long long burst = nextBurst(o, &r);
+
+      appendText(&b, "process name P");
+      appendInt(&b, i + 1);
+      appendText(&b, " arrival ");
+      appendInt(&b, arrival);
+      appendText(&b, " burst ");
+      appendInt(&b, burst);
+      appendText(&b, "\n");
+   }
+   appendText(&b, "end\n");
+
+   *size = b.length;
+   return b.data;
+}
+
+/** Distributions **/
+// splitmix64, which is fast and good enough for a workload.
+void seedRandom(randomSource* r, unsigned long long seed)
+{
+   r->state = seed;
+}
+
+// A uniform number in (0, 1), never exactly 0 so that it can be logged.
+double nextUniform(randomSource* r)
+{
+   unsigned long long z = (r->state += 0x9E3779B97F4A7C15ULL);
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   z ^= z >> 31;
+
+   return ((z >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Advance the arrival clock by an exponential gap and return the arrival
+// time of the process with the given index.
+long long nextArrivalGap(const workloadOptions* o, randomSource* r, int idx, double* clock)
+{
+   double rate = effectiveRate(o);
+
+   if (ArrivalsBursty == o->arrivals)
+   {
+      rate = (0 == (idx / o->phaseLength) % 2) ? (rate * o->burstiness) : (rate / o->burstiness);
+   }
+
+   *clock += -log(nextUniform(r)) / rate;
+
+   return (long long) *clock;
+}
+
+long long nextBurst(const workloadOptions* o, randomSource* r)
+{
+   double burst;
+
+   if (BurstsPareto == o->bursts)
+   {
+      // Scale so that the mean of the distribution is meanBurst.
+      double minimum = o->meanBurst * (o->paretoShape - 1) / o->paretoShape;
+      burst = minimum / pow(nextUniform(r), 1.0 / o->paretoShape);
+   }
+   else
+   {
+      burst = -log(nextUniform(r)) * o->meanBurst;
+   }
+
+   return (burst < 1) ? 1 : llround(burst);
+}
+
+double effectiveRate(const workloadOptions* o)
+{
+   if (o->arrivalRate > 0)
+   {
+      return o->arrivalRate;
+   }
+
+   return 0.9 * o->cpuCount / o->meanBurst;
+}
+
+// Every algorithm keeps the CPUs busy while there is work, so the time at
+// which a greedy FCFS finishes is about when any of them would.
+long long estimateRuntime(const workloadOptions* o)
+{
+   long long* freeAt = calloc(o->cpuCount, sizeof(long long));
+   long long end = 0;
+
+   randomSource r;
+   seedRandom(&r, o->seed);
+   double clock = 0;
+
+   int i;
+   for (i = 0; i < o->processCount; i++)
+   {
+      long long arrival = nextArrivalGap(o, &r, i, &clock);
+      long long burst = nextBurst(o, &r);
+
+      int cpu = 0;
+      int c;
+      for (c = 1; c < o->cpuCount; c++)
+      {
+         if (freeAt[c] < freeAt[cpu])
+         {
+            cpu = c;
+         }
+      }
+
+      freeAt[cpu] = ((freeAt[cpu] > arrival) ? freeAt[cpu] : arrival) + burst;
+      if (freeAt[cpu] > end)
+      {
+         end = freeAt[cpu];
+      }
+   }
+
+   free(freeAt);
+   return (end > 0) ? end : 1;
+}
+
+/** Text buffer **/
+void appendText(textBuffer* b, const char* text)
+{
+   size_t length = strlen(text);
+
+   if (b->length + length > b->capacity)
+   {
+      b->capacity = (b->capacity > 0) ? (2 * b->capacity) : (1 << 16);
+      if (b->capacity < b->length + length)
+      {
+         b->capacity = b->length + length;
+      }
+      b->data = realloc(b->data, b->capacity);
+   }
+
+   memcpy(b->data + b->length, text, length);
+   b->length += length;
+}
+
+void appendInt(textBuffer* b, long long val)
+{
+   char digits[24];
+   snprintf(digits, sizeof(digits), "%lld", val);
+   appendText(b, digits);
+}
@@ -0,0 +1,60 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Synthetic workloads for the scheduler, written in the format of
+// processes.in. The same options and seed always give the same workload.
+
+typedef enum
+{
+   // Exponential gaps between arrivals at a steady rate.
+   ArrivalsPoisson,
+   // Poisson arrivals whose rate alternates between busy and quiet phases.
+   ArrivalsBursty
+} arrivalPattern;
+
+typedef enum
+{
+   BurstsExponential,
+   // Heavy tailed: most bursts are short, a few are very long.
+   BurstsPareto
+} burstDistribution;
+
+typedef struct
+{
+   int processCount;
+   // Written to the "use" line: fcfs, sjf, rr, mlfq or cfs.
+   const char* algorithm;
+   long long quantum;
+   int cpuCount;
+   arrivalPattern arrivals;
+   // Mean arrivals per time unit, or 0 for a rate that keeps the CPUs
+   // about 90% busy.
+   double arrivalRate;
+   // Bursty phases of this many processes arrive at arrivalRate times
+   // burstiness, then at arrivalRate divided by it, and so on.
+   int phaseLength;
+   double burstiness;
+   burstDistribution bursts;
+   double meanBurst;
+   // Shape of the Pareto distribution, above 1. Smaller is heavier tailed.
+   double paretoShape;
+   // Time to run for, or 0 to run until a greedy FCFS would have finished
+   // every process.
+   long long runtime;
+   unsigned long long seed;
+} workloadOptions;
+
+void setDefaultWorkload(workloadOptions* o);
+
+// Set the option with the given name, like "--count", from its value.
+// Returns -1 if the option is unknown or its value is invalid.
+int setWorkloadOption(workloadOptions* o, const char* name, const char* value);
+void printWorkloadUsage(FILE* file);
+
+// Generate a workload into a buffer that the caller frees.
+char* generateWorkload(const workloadOptions* o, size_t* size);
+
+#endif